@@ -1,10 +1,10 @@
 import esphome.codegen as cg
-from esphome.components import ble_client
+from esphome.components import ble_client, uart
 import esphome.config_validation as cv
-from esphome.const import CONF_ID, CONF_PASSWORD
+from esphome.const import CONF_ID, CONF_PASSWORD, CONF_UART_ID
+from esphome.core import CORE
 
 CODEOWNERS = ["@syssi"]
-DEPENDENCIES = ["ble_client"]
 AUTO_LOAD = ["binary_sensor", "button", "number", "sensor", "text_sensor", "switch"]
 MULTI_CONF = True
 
@@ -12,11 +12,62 @@ CONF_DALY_BMS_BLE_ID = "daly_bms_ble_id"
 CONF_PROTOCOL_VERSION = "protocol_version"
 CONF_STATUS_REGISTERS = "status_registers"
 CONF_RESPONSE_TIMEOUT = "response_timeout"
+CONF_PIPELINE_DEPTH = "pipeline_depth"
+CONF_READ_RETRIES = "read_retries"
+CONF_WRITE_RETRIES = "write_retries"
+CONF_RETRY_BACKOFF = "retry_backoff"
+CONF_ALARMS_UPDATE_INTERVAL = "alarms_update_interval"
+CONF_SETTINGS_UPDATE_INTERVAL = "settings_update_interval"
+CONF_MTU = "mtu"
+CONF_ACTIVE_CONNECTION_INTERVAL = "active_connection_interval"
+CONF_IDLE_CONNECTION_INTERVAL = "idle_connection_interval"
+CONF_CACHE_GATT_HANDLES = "cache_gatt_handles"
+CONF_HEARTBEAT_INTERVAL = "heartbeat_interval"
+CONF_CELL_VOLTAGE_DEADBAND = "cell_voltage_deadband"
+CONF_TEMPERATURE_DEADBAND = "temperature_deadband"
+CONF_CURRENT_DEADBAND = "current_deadband"
+CONF_STATE_OF_CHARGE_DEADBAND = "state_of_charge_deadband"
+CONF_HOST_DEVICE = "host_device"
+CONF_TRANSPORT_ID = "transport_id"
 
 daly_bms_ble_ns = cg.esphome_ns.namespace("daly_bms_ble")
 DalyBmsBle = daly_bms_ble_ns.class_(
     "DalyBmsBle", ble_client.BLEClientNode, cg.PollingComponent
 )
+DalyBmsTransport = daly_bms_ble_ns.class_("DalyBmsTransport")
+DalyBmsUartTransport = daly_bms_ble_ns.class_(
+    "DalyBmsUartTransport", DalyBmsTransport, uart.UARTDevice
+)
+DalyBmsHostTransport = daly_bms_ble_ns.class_("DalyBmsHostTransport", DalyBmsTransport)
+
+TRANSPORT_KEYS = (ble_client.CONF_BLE_CLIENT_ID, CONF_UART_ID, CONF_HOST_DEVICE)
+# Options of the BLE link, meaningless on a wired or host transport
+BLE_ONLY_KEYS = (
+    CONF_MTU,
+    CONF_ACTIVE_CONNECTION_INTERVAL,
+    CONF_IDLE_CONNECTION_INTERVAL,
+    CONF_CACHE_GATT_HANDLES,
+)
+
+CONNECTION_INTERVAL = cv.All(
+    cv.positive_time_period_milliseconds,
+    cv.Range(min=cv.TimePeriod(milliseconds=8), max=cv.TimePeriod(seconds=4)),
+)
+
+
+def _validate_transport(config):
+    # The host platform may run without a link, the unit tests attach their own
+    if not CORE.is_host and not any(key in config for key in TRANSPORT_KEYS):
+        raise cv.Invalid(f"One of {', '.join(TRANSPORT_KEYS)} is required")
+    if ble_client.CONF_BLE_CLIENT_ID not in config:
+        for key in BLE_ONLY_KEYS:
+            # cache_gatt_handles defaults to false
+            if config.get(key, False) is not False:
+                raise cv.Invalid(
+                    f"{key} requires {ble_client.CONF_BLE_CLIENT_ID}", path=[key]
+                )
+    return config
+
 
 DALY_BMS_BLE_COMPONENT_SCHEMA = cv.Schema(
     {
@@ -37,19 +88,103 @@ CONFIG_SCHEMA = cv.All(
             cv.Optional(
                 CONF_RESPONSE_TIMEOUT, default="3s"
             ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_PIPELINE_DEPTH, default=1): cv.int_range(min=1, max=8),
+            cv.Optional(CONF_READ_RETRIES, default=2): cv.int_range(min=0, max=10),
+            cv.Optional(CONF_WRITE_RETRIES, default=5): cv.int_range(min=0, max=10),
+            cv.Optional(
+                CONF_RETRY_BACKOFF, default="100ms"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_ALARMS_UPDATE_INTERVAL, default="30s"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(
+                CONF_SETTINGS_UPDATE_INTERVAL, default="5min"
+            ): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_MTU): cv.int_range(min=23, max=517),
+            cv.Optional(CONF_ACTIVE_CONNECTION_INTERVAL): CONNECTION_INTERVAL,
+            cv.Optional(CONF_IDLE_CONNECTION_INTERVAL): CONNECTION_INTERVAL,
+            cv.Optional(CONF_CACHE_GATT_HANDLES, default=False): cv.boolean,
+            cv.Optional(CONF_HEARTBEAT_INTERVAL): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_CELL_VOLTAGE_DEADBAND, default=0.0): cv.positive_float,
+            cv.Optional(CONF_TEMPERATURE_DEADBAND, default=0.0): cv.positive_float,
+            cv.Optional(CONF_CURRENT_DEADBAND, default=0.0): cv.positive_float,
+            cv.Optional(CONF_STATE_OF_CHARGE_DEADBAND, default=0.0): cv.positive_float,
+            cv.Optional(ble_client.CONF_BLE_CLIENT_ID): cv.use_id(
+                ble_client.BLEClient
+            ),
+            cv.Optional(CONF_UART_ID): cv.use_id(uart.UARTComponent),
+            cv.Optional(CONF_HOST_DEVICE): cv.All(cv.only_on("host"), cv.string),
+            cv.GenerateID(CONF_TRANSPORT_ID): cv.declare_id(DalyBmsTransport),
         }
-    )
-    .extend(ble_client.BLE_CLIENT_SCHEMA)
-    .extend(cv.polling_component_schema("10s")),
+    ).extend(cv.polling_component_schema("10s")),
+    cv.has_at_most_one_key(*TRANSPORT_KEYS),
+    _validate_transport,
 )
 
 
+def _final_validate(config):
+    if CONF_UART_ID in config:
+        uart.final_validate_device_schema(
+            "daly_bms_ble", baud_rate=9600, require_tx=True, require_rx=True
+        )(config)
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
+
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
-    await ble_client.register_ble_node(var, config)
+
+    if CONF_UART_ID in config:
+        cg.add_define("USE_DALY_BMS_BLE_TRANSPORT_UART")
+        transport = cg.Pvariable(
+            config[CONF_TRANSPORT_ID], DalyBmsUartTransport.new(), DalyBmsUartTransport
+        )
+        await uart.register_uart_device(transport, config)
+        cg.add(var.set_transport(transport))
+    elif CONF_HOST_DEVICE in config:
+        transport = cg.Pvariable(
+            config[CONF_TRANSPORT_ID],
+            DalyBmsHostTransport.new(config[CONF_HOST_DEVICE]),
+            DalyBmsHostTransport,
+        )
+        cg.add(var.set_transport(transport))
+    elif ble_client.CONF_BLE_CLIENT_ID in config:
+        cg.add_define("USE_DALY_BMS_BLE_TRANSPORT_BLE")
+        await ble_client.register_ble_node(var, config)
 
     cg.add(var.set_password(config[CONF_PASSWORD]))
     cg.add(var.set_protocol_version(config[CONF_PROTOCOL_VERSION]))
+    # The platforms add a feature define for every group of configured entities
+    cg.add_define("USE_DALY_BMS_BLE_ENTITY_FEATURES")
+    # Only the protocols in use are compiled in
+    if config[CONF_PROTOCOL_VERSION] == 0x81:
+        cg.add_define("USE_DALY_BMS_BLE_PROTOCOL_P81")
+    else:
+        cg.add_define("USE_DALY_BMS_BLE_PROTOCOL_D2")
     cg.add(var.set_status_registers(config[CONF_STATUS_REGISTERS]))
     cg.add(var.set_response_timeout(config[CONF_RESPONSE_TIMEOUT]))
+    cg.add(var.set_pipeline_depth(config[CONF_PIPELINE_DEPTH]))
+    cg.add(var.set_read_retries(config[CONF_READ_RETRIES]))
+    cg.add(var.set_write_retries(config[CONF_WRITE_RETRIES]))
+    cg.add(var.set_retry_backoff(config[CONF_RETRY_BACKOFF]))
+    cg.add(var.set_alarms_update_interval(config[CONF_ALARMS_UPDATE_INTERVAL]))
+    cg.add(var.set_settings_update_interval(config[CONF_SETTINGS_UPDATE_INTERVAL]))
+    cg.add(var.set_cache_gatt_handles(config[CONF_CACHE_GATT_HANDLES]))
+    cg.add(var.set_cell_voltage_deadband(config[CONF_CELL_VOLTAGE_DEADBAND]))
+    cg.add(var.set_temperature_deadband(config[CONF_TEMPERATURE_DEADBAND]))
+    cg.add(var.set_current_deadband(config[CONF_CURRENT_DEADBAND]))
+    cg.add(var.set_state_of_charge_deadband(config[CONF_STATE_OF_CHARGE_DEADBAND]))
+
+    if CONF_HEARTBEAT_INTERVAL in config:
+        cg.add(var.set_heartbeat_interval(config[CONF_HEARTBEAT_INTERVAL]))
+    if CONF_MTU in config:
+        cg.add(var.set_mtu(config[CONF_MTU]))
+    if CONF_ACTIVE_CONNECTION_INTERVAL in config:
+        cg.add(
+            var.set_active_connection_interval(config[CONF_ACTIVE_CONNECTION_INTERVAL])
+        )
+    if CONF_IDLE_CONNECTION_INTERVAL in config:
+        cg.add(var.set_idle_connection_interval(config[CONF_IDLE_CONNECTION_INTERVAL]))
@@ -1,7 +1,12 @@
 import esphome.codegen as cg
 from esphome.components import button
 import esphome.config_validation as cv
-from esphome.const import CONF_FACTORY_RESET, CONF_RESTART, DEVICE_CLASS_RESTART
+from esphome.const import (
+    CONF_FACTORY_RESET,
+    CONF_RESTART,
+    DEVICE_CLASS_RESTART,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+)
 
 from .. import CONF_DALY_BMS_BLE_ID, DALY_BMS_BLE_COMPONENT_SCHEMA, daly_bms_ble_ns
 
@@ -13,6 +18,7 @@ CONF_RETRIEVE_SETTINGS = "retrieve_settings"
 CONF_RETRIEVE_VERSION = "retrieve_version"
 CONF_SHUTDOWN = "shutdown"
 CONF_RESET_CURRENT = "reset_current"
+CONF_DUMP_DIAGNOSTICS = "dump_diagnostics"
 
 ICON_RETRIEVE_SETTINGS = "mdi:cog"
 ICON_RETRIEVE_VERSION = "mdi:information"
@@ -20,6 +26,7 @@ ICON_RESTART = "mdi:restart"
 ICON_SHUTDOWN = "mdi:power"
 ICON_RESET_CURRENT = "mdi:counter"
 ICON_FACTORY_RESET = "mdi:factory"
+ICON_DUMP_DIAGNOSTICS = "mdi:stethoscope"
 
 DALY_FUNCTION_READ = 0x03
 DALY_FUNCTION_WRITE = 0x06
@@ -35,6 +42,9 @@ BUTTONS = {
 }
 
 DalyButton = daly_bms_ble_ns.class_("DalyButton", button.Button, cg.Component)
+DalyDiagnosticsButton = daly_bms_ble_ns.class_(
+    "DalyDiagnosticsButton", button.Button, cg.Component
+)
 
 CONFIG_SCHEMA = DALY_BMS_BLE_COMPONENT_SCHEMA.extend(
     {
@@ -56,6 +66,11 @@ CONFIG_SCHEMA = DALY_BMS_BLE_COMPONENT_SCHEMA.extend(
         cv.Optional(CONF_FACTORY_RESET): button.button_schema(
             DalyButton, icon=ICON_FACTORY_RESET, device_class=DEVICE_CLASS_RESTART
         ),
+        cv.Optional(CONF_DUMP_DIAGNOSTICS): button.button_schema(
+            DalyDiagnosticsButton,
+            icon=ICON_DUMP_DIAGNOSTICS,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
     }
 )
 
@@ -71,3 +86,9 @@ async def to_code(config):
             cg.add(var.set_function(function))
             cg.add(var.set_holding_register(address))
             cg.add(var.set_value(value))
+
+    if CONF_DUMP_DIAGNOSTICS in config:
+        conf = config[CONF_DUMP_DIAGNOSTICS]
+        var = await button.new_button(conf)
+        await cg.register_component(var, conf)
+        cg.add(var.set_parent(hub))
@@ -9,4 +9,7 @@ static const char *const TAG = "daly_bms_ble.button";
 void DalyButton::dump_config() { LOG_BUTTON("", "DalyBmsBle Button", this); }
 void DalyButton::press_action() { this->parent_->send_command(this->function_, this->holding_register_, this->value_); }
 
+void DalyDiagnosticsButton::dump_config() { LOG_BUTTON("", "DalyBmsBle Diagnostics Button", this); }
+void DalyDiagnosticsButton::press_action() { this->parent_->dump_diagnostics(); }
+
 }  // namespace esphome::daly_bms_ble
@@ -25,4 +25,15 @@ class DalyButton : public button::Button, public Component {
   uint16_t value_{0};
 };
 
+class DalyDiagnosticsButton : public button::Button, public Component {
+ public:
+  void set_parent(DalyBmsBle *parent) { this->parent_ = parent; };
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::DATA; }
+
+ protected:
+  void press_action() override;
+  DalyBmsBle *parent_;
+};
+
 }  // namespace esphome::daly_bms_ble
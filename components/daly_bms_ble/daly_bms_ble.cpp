@@ -3,6 +3,9 @@
 #include "esphome/core/helpers.h"
 #include "esphome/core/version.h"
 
+#include <cinttypes>
+#include <cstring>
+
 #if ESPHOME_VERSION_CODE >= VERSION_CODE(2025, 12, 0)
 #define ADDR_STR(x) x
 #else
@@ -64,8 +67,59 @@ static const uint8_t DALY_FRAME_LEN_P81_SETTINGS3 = 80 * 2;
 static const uint8_t DALY_FRAME_LEN_P81_SETTINGS4 = 11 * 2;
 static const uint8_t DALY_FRAME_LEN_P81_SETTINGS5 = 2 * 2;
 
-static const uint8_t MAX_RESPONSE_SIZE = 170;
+enum PollTier : uint8_t {
+  POLL_TIER_REALTIME,  // every update
+  POLL_TIER_ALARMS,    // alarms_update_interval
+  POLL_TIER_SETTINGS,  // settings_update_interval
+  POLL_TIER_STATIC,    // once per connection
+};
+
+struct PollBlock {
+  uint16_t address;
+  uint8_t registers;  // 0: status_registers
+  PollTier tier;
+};
+
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_D2
+static const PollBlock D2_POLL_BLOCKS[] = {
+    {DALY_COMMAND_REQ_STATUS_START, 0, POLL_TIER_REALTIME},
+    {DALY_COMMAND_REQ_SETTINGS_START, DALY_FRAME_LEN_SETTINGS / 2, POLL_TIER_SETTINGS},
+    {DALY_COMMAND_REQ_BALANCER_SWITCH, DALY_FRAME_LEN_BALANCER_SWITCH / 2, POLL_TIER_SETTINGS},
+};
+#endif
+
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+static const PollBlock P81_POLL_BLOCKS[] = {
+    {DALY_COMMAND_REQ_P81_CELLS_START, DALY_FRAME_LEN_P81_CELLS / 2, POLL_TIER_REALTIME},
+    {DALY_COMMAND_REQ_P81_STATUS_START, DALY_FRAME_LEN_P81_STATUS / 2, POLL_TIER_REALTIME},
+    {DALY_COMMAND_REQ_P81_ALARMS_START, DALY_FRAME_LEN_P81_ALARMS / 2, POLL_TIER_ALARMS},
+    {DALY_COMMAND_REQ_P81_VERSION_START, DALY_FRAME_LEN_P81_VERSION / 2, POLL_TIER_STATIC},
+    {DALY_COMMAND_REQ_P81_SETTINGS1_START, DALY_FRAME_LEN_P81_SETTINGS1 / 2, POLL_TIER_SETTINGS},
+    {DALY_COMMAND_REQ_P81_SETTINGS2_START, DALY_FRAME_LEN_P81_SETTINGS2 / 2, POLL_TIER_SETTINGS},
+    {DALY_COMMAND_REQ_P81_SETTINGS3_START, DALY_FRAME_LEN_P81_SETTINGS3 / 2, POLL_TIER_SETTINGS},
+    {DALY_COMMAND_REQ_P81_SETTINGS4_START, DALY_FRAME_LEN_P81_SETTINGS4 / 2, POLL_TIER_SETTINGS},
+    {DALY_COMMAND_REQ_P81_SETTINGS5_START, DALY_FRAME_LEN_P81_SETTINGS5 / 2, POLL_TIER_SETTINGS},
+    {DALY_COMMAND_REQ_BALANCER_SWITCH, DALY_FRAME_LEN_BALANCER_SWITCH / 2, POLL_TIER_SETTINGS},
+};
+#endif
+
+static const PollBlock *poll_blocks(bool p81, size_t &count) {
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+  if (p81) {
+    count = sizeof(P81_POLL_BLOCKS) / sizeof(P81_POLL_BLOCKS[0]);
+    return P81_POLL_BLOCKS;
+  }
+#endif
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_D2
+  count = sizeof(D2_POLL_BLOCKS) / sizeof(D2_POLL_BLOCKS[0]);
+  return D2_POLL_BLOCKS;
+#else
+  count = 0;
+  return nullptr;
+#endif
+}
 
+#ifdef USE_DALY_BMS_BLE_ERRORS
 static const uint8_t ERRORS_SIZE = 64;
 static constexpr const char *const ERRORS[ERRORS_SIZE] = {
     // Register 0x3D, Byte 0
@@ -150,19 +204,33 @@ static constexpr const char *const ERRORS[ERRORS_SIZE] = {
     "Warning: Discharging temperature too low",
     "Critical: Discharging temperature too low",
 };
+#endif
 
-static void log_frame_hex(const char *tag, const char *label, const std::vector<uint8_t> &data) {
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+// Undecoded register blocks are only logged in full by a diagnostic dump, or at VERBOSE
+static void log_frame_hex(const char *tag, const char *label, FrameView data, bool dump) {
   constexpr size_t chunk = 96;
-  ESP_LOGI(tag, "%s (%zu bytes):", label, data.size());
+  if (dump) {
+    ESP_LOGI(tag, "%s (%zu bytes):", label, data.size());
+    for (size_t i = 0; i < data.size(); i += chunk) {
+      ESP_LOGI(tag, "  +%03zu: %s", i,
+               format_hex_pretty(data.data() + i, std::min(chunk, data.size() - i)).c_str());  // NOLINT
+    }
+    return;
+  }
+#if ESPHOME_LOG_LEVEL >= ESPHOME_LOG_LEVEL_VERBOSE
+  ESP_LOGV(tag, "%s (%zu bytes):", label, data.size());
   for (size_t i = 0; i < data.size(); i += chunk) {
-    ESP_LOGI(tag, "  +%03zu: %s", i,
+    ESP_LOGV(tag, "  +%03zu: %s", i,
              format_hex_pretty(data.data() + i, std::min(chunk, data.size() - i)).c_str());  // NOLINT
   }
+#endif
 }
+#endif
 
 std::array<uint8_t, 8> DalyBmsBle::build_frame_(uint8_t function, uint16_t address, uint16_t value) const {
   std::array<uint8_t, 8> frame;
-  frame[0] = this->protocol_version_ == DALY_PROTOCOL_P81 ? DALY_FRAME_START_P81_REQ : DALY_FRAME_START;
+  frame[0] = this->is_p81_() ? DALY_FRAME_START_P81_REQ : DALY_FRAME_START;
   frame[1] = function;
   frame[2] = address >> 8;
   frame[3] = address >> 0;
@@ -174,58 +242,309 @@ std::array<uint8_t, 8> DalyBmsBle::build_frame_(uint8_t function, uint16_t addre
   return frame;
 }
 
-void DalyBmsBle::queue_command_(uint8_t function, uint16_t address, uint16_t value) {
-  if (!this->queue_.enqueue(function, address, value))
-    ESP_LOGW(TAG, "Command queue full, dropping: func=0x%02X addr=0x%04X val=0x%04X", function, address, value);
-}
+bool DalyBmsBle::queue_command_(uint8_t function, uint16_t address, uint16_t value) {
+  // A read of a block which is queued already is answered by the pending copy
+  if (function != DALY_FUNCTION_WRITE && this->queue_.contains(function, address, value)) {
+    ESP_LOGV(TAG, "Read already queued: addr=0x%04X val=0x%04X", address, value);
+    return true;
+  }
 
-void DalyBmsBle::advance_command_queue_() {
-  this->queue_.advance();
-  this->send_next_command_();
+  CommandQueue::Command evicted;
+  if (function == DALY_FUNCTION_WRITE && this->queue_.full() && this->queue_.evict_newest_read(evicted)) {
+    ESP_LOGW(TAG, "Command queue full, evicting read: addr=0x%04X val=0x%04X", evicted.address, evicted.value);
+  }
+
+  if (!this->queue_.enqueue(function, address, value)) {
+    ESP_LOGW(TAG, "Command queue full, dropping: func=0x%02X addr=0x%04X val=0x%04X", function, address, value);
+    return false;
+  }
+  return true;
 }
 
 void DalyBmsBle::send_command(uint8_t function, uint16_t address, uint16_t value) {
+  // The response to an explicit read is decoded and logged even if it didn't change
+  this->invalidate_poll_block_(address);
+  if (function != DALY_FUNCTION_WRITE)
+    this->dump_pending_ = true;
   this->queue_command_(function, address, value);
   this->send_next_command_();
 }
 
-#ifdef USE_ESP32
+void DalyBmsBle::queue_poll_blocks_(uint32_t now) {
+  // Every block of the compiled protocols needs a slot of the per-block state and a bit of the polled mask
+  static_assert(MAX_POLL_BLOCKS <= sizeof(this->poll_block_polled_) * 8, "Polled mask too small");
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_D2
+  static_assert(sizeof(D2_POLL_BLOCKS) / sizeof(D2_POLL_BLOCKS[0]) <= MAX_POLL_BLOCKS, "Too many D2 poll blocks");
+#endif
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+  static_assert(sizeof(P81_POLL_BLOCKS) / sizeof(P81_POLL_BLOCKS[0]) <= MAX_POLL_BLOCKS, "Too many P81 poll blocks");
+#endif
+  size_t count;
+  const PollBlock *blocks = poll_blocks(this->is_p81_(), count);
+
+  if (this->queue_.contains_reads()) {
+    this->poll_cycle_overruns_++;
+    ESP_LOGW(TAG, "Poll cycle overrun, %u commands still queued (consider a longer update_interval)",
+             this->queue_.size());
+  }
+  if (!this->queue_.contains_reads())
+    this->dump_pending_ = false;
+  // Publish the realtime values of an incomplete cycle as far as they were received
+  if (this->snapshot_pending_ != 0)
+    this->commit_snapshot_();
+
+  for (size_t i = 0; i < count; i++) {
+    const PollBlock &block = blocks[i];
+    const uint16_t mask = 1 << i;
+    if (this->poll_block_polled_ & mask) {
+      uint32_t interval;
+      switch (block.tier) {
+        case POLL_TIER_REALTIME:
+          interval = 0;
+          break;
+        case POLL_TIER_ALARMS:
+          interval = this->alarms_update_interval_;
+          break;
+        case POLL_TIER_SETTINGS:
+          interval = this->settings_update_interval_;
+          break;
+        default:
+          // Static blocks are read once per connection
+          continue;
+      }
+      if (now - this->poll_block_millis_[i] < interval)
+        continue;
+    }
+
+    uint16_t registers = block.registers != 0 ? block.registers : this->status_registers_;
+    if (!this->queue_command_(DALY_FUNCTION_READ, block.address, registers))
+      continue;
+    if (block.tier == POLL_TIER_REALTIME)
+      this->snapshot_pending_ |= mask;
+    this->poll_block_polled_ |= mask;
+    this->poll_block_millis_[i] = now;
+  }
+}
+
+void DalyBmsBle::invalidate_poll_block_(uint16_t address) {
+  size_t count;
+  const PollBlock *blocks = poll_blocks(this->is_p81_(), count);
+
+  for (size_t i = 0; i < count; i++) {
+    uint16_t registers = blocks[i].registers != 0 ? blocks[i].registers : this->status_registers_;
+    if (address >= blocks[i].address && address < blocks[i].address + registers) {
+      this->poll_block_polled_ &= ~(1 << i);
+      this->poll_block_frames_[i].length = 0;
+    }
+  }
+}
+
+bool DalyBmsBle::skip_unchanged_frame_(FrameView data, uint16_t address) {
+  size_t count;
+  const PollBlock *blocks = poll_blocks(this->is_p81_(), count);
+
+  for (size_t i = 0; i < count; i++) {
+    // Realtime values are always decoded, they feed the publish-on-change and heartbeat logic
+    if (blocks[i].address != address || blocks[i].tier == POLL_TIER_REALTIME)
+      continue;
+
+    // The CRC has been verified already, together with the length it identifies the payload
+    auto &last = this->poll_block_frames_[i];
+    const uint16_t crc = uint16_t(data[data.size() - 2]) | (uint16_t(data[data.size() - 1]) << 8);
+    if (last.length == data.size() && last.crc == crc) {
+      this->poll_block_skipped_[i]++;
+      this->skipped_frames_++;
+      ESP_LOGV(TAG, "Response to 0x%04X unchanged, skipped (%" PRIu32 " times)", address,
+               this->poll_block_skipped_[i]);
+      return true;
+    }
+    last = {crc, (uint8_t) data.size()};
+    return false;
+  }
+  return false;
+}
+
+bool DalyBmsBle::is_connected_() const {
+  if (this->transport_ != nullptr)
+    return this->transport_->is_connected();
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
+  return this->node_state == espbt::ClientState::ESTABLISHED;
+#else
+  return false;
+#endif
+}
+
+bool DalyBmsBle::write_frame_(const uint8_t *data, size_t length) {
+  if (this->transport_ != nullptr)
+    return this->transport_->write_frame(data, length);
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
+  auto status = esp_ble_gattc_write_char(this->parent_->get_gattc_if(), this->parent_->get_conn_id(),
+                                         this->char_command_handle_, length, const_cast<uint8_t *>(data),
+                                         ESP_GATT_WRITE_TYPE_NO_RSP, ESP_GATT_AUTH_REQ_NONE);
+  if (status) {
+    ESP_LOGW(TAG, "[%s] esp_ble_gattc_write_char failed, status=%d", ADDR_STR(this->parent_->address_str()), status);
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
 void DalyBmsBle::send_next_command_() {
-  if (this->queue_.pending() || this->node_state != espbt::ClientState::ESTABLISHED || this->queue_.empty())
+  if (!this->is_connected_())
     return;
-  auto &cmd = this->queue_.front();
 
-  auto frame = this->build_frame_(cmd.function, cmd.address, cmd.value);
-  ESP_LOGD(TAG, "Send command (handle 0x%02X): %s", this->char_command_handle_,
-           format_hex_pretty(frame.data(), frame.size()).c_str());  // NOLINT
+  while (this->queue_.ready(this->millis_())) {
+    auto &cmd = this->queue_.next_unsent();
+
+    auto frame = this->build_frame_(cmd.function, cmd.address, cmd.value);
+    ESP_LOGV(TAG, "Send command (in flight %u): %s", this->queue_.in_flight(),
+             format_hex_pretty(frame.data(), frame.size()).c_str());  // NOLINT
 
-  auto status =
-      esp_ble_gattc_write_char(this->parent_->get_gattc_if(), this->parent_->get_conn_id(), this->char_command_handle_,
-                               frame.size(), frame.data(), ESP_GATT_WRITE_TYPE_NO_RSP, ESP_GATT_AUTH_REQ_NONE);
+    if (!this->write_frame_(frame.data(), frame.size())) {
+      if (this->retry_command_(this->queue_.in_flight(), this->millis_()))
+        break;
+      continue;
+    }
 
+    this->queue_.mark_pending(this->millis_(), this->round_trip_timer_.timeout_ms(cmd.function, cmd.address));
+  }
+
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
+  // Fast connection interval while a poll cycle is in progress, relaxed one in between
+  if (this->transport_ == nullptr && this->queue_.empty() == this->connection_active_)
+    this->request_connection_interval_(!this->queue_.empty());
+#endif
+}
+
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
+void DalyBmsBle::request_connection_interval_(bool active) {
+  this->connection_active_ = active;
+  uint16_t interval = active ? this->active_connection_interval_ : this->idle_connection_interval_;
+  if (interval == 0)
+    return;
+
+  esp_ble_conn_update_params_t params = {};
+  memcpy(params.bda, this->parent_->get_remote_bda(), sizeof(esp_bd_addr_t));
+  params.min_int = interval;
+  params.max_int = interval;
+  params.latency = 0;
+  // Supervision timeout in units of 10 ms: at least 6 s and 4 connection intervals
+  params.timeout = std::min<uint16_t>(3200, std::max<uint16_t>(600, interval / 2));
+
+  ESP_LOGD(TAG, "[%s] Requesting %s connection interval of %.2f ms", ADDR_STR(this->parent_->address_str()),
+           active ? "active" : "idle", interval * 1.25f);
+  auto status = esp_ble_gap_update_conn_params(&params);
   if (status) {
-    ESP_LOGW(TAG, "[%s] esp_ble_gattc_write_char failed, status=%d", ADDR_STR(this->parent_->address_str()), status);
-    this->queue_.advance();
+    ESP_LOGW(TAG, "[%s] esp_ble_gap_update_conn_params failed, status=%d", ADDR_STR(this->parent_->address_str()),
+             status);
+  }
+}
+
+void DalyBmsBle::setup() {
+  // The BLE client code is compiled in as soon as one hub uses BLE, a hub on another transport has no parent
+  if (this->transport_ != nullptr)
     return;
+
+  if (this->cache_gatt_handles_) {
+    const uint64_t address = this->parent_->get_address();
+    const uint32_t hash = fnv1_hash("daly_bms_ble_handles_v2") ^ uint32_t(address) ^ uint32_t(address >> 32);
+    this->handle_cache_pref_ = global_preferences->make_preference<HandleCache>(hash);
+    if (!this->handle_cache_pref_.load(&this->handle_cache_))
+      this->handle_cache_ = {0, 0, 0};
   }
 
-  this->queue_.mark_pending(millis());
+  if (this->mtu_ != 0) {
+    // The local MTU applies to all connections of this node
+    auto status = esp_ble_gatt_set_local_mtu(this->mtu_);
+    if (status) {
+      ESP_LOGW(TAG, "esp_ble_gatt_set_local_mtu failed, status=%d", status);
+    }
+  }
+}
+
+bool DalyBmsBle::register_for_notify_() {
+  auto status = esp_ble_gattc_register_for_notify(this->parent()->get_gattc_if(), this->parent()->get_remote_bda(),
+                                                  this->char_notify_handle_);
+  if (status) {
+    ESP_LOGW(TAG, "esp_ble_gattc_register_for_notify failed, status=%d", status);
+    return false;
+  }
+  return true;
+}
+
+// Without service discovery the BLE client doesn't know the CCCD, the notifications are enabled here
+bool DalyBmsBle::write_cccd_() {
+  uint8_t value[2] = {0x01, 0x00};
+  auto status = esp_ble_gattc_write_char_descr(this->parent_->get_gattc_if(), this->parent_->get_conn_id(),
+                                               this->handle_cache_.cccd_handle, sizeof(value), value,
+                                               ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
+  if (status) {
+    ESP_LOGW(TAG, "[%s] esp_ble_gattc_write_char_descr failed, status=%d", ADDR_STR(this->parent_->address_str()),
+             status);
+    return false;
+  }
+  return true;
+}
+
+void DalyBmsBle::establish_() {
+  this->node_state = espbt::ClientState::ESTABLISHED;
+  this->update();
 }
-#else
-void DalyBmsBle::send_next_command_() {}
 #endif
 
-#ifdef USE_ESP32
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
 void DalyBmsBle::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
                                      esp_ble_gattc_cb_param_t *param) {
   switch (event) {
     case ESP_GATTC_OPEN_EVT: {
+      if (param->open.status != ESP_GATT_OK)
+        break;
+      this->connect_millis_ = this->millis_();
+      this->awaiting_first_frame_ = true;
+
+      if (this->mtu_ != 0) {
+        // The BLE client may have started the exchange already, the result arrives with ESP_GATTC_CFG_MTU_EVT
+        auto status = esp_ble_gattc_send_mtu_req(this->parent_->get_gattc_if(), param->open.conn_id);
+        if (status) {
+          ESP_LOGD(TAG, "[%s] esp_ble_gattc_send_mtu_req failed, status=%d", ADDR_STR(this->parent_->address_str()),
+                   status);
+        }
+      }
+
+      // Start polling with the handles of the last connection once the notifications are enabled, service
+      // discovery verifies the handles later on
+      if (this->cache_gatt_handles_ && this->handle_cache_.notify_handle != 0 &&
+          this->handle_cache_.command_handle != 0 && this->handle_cache_.cccd_handle != 0) {
+        ESP_LOGD(TAG, "[%s] Using cached handles (notify 0x%02X, command 0x%02X, cccd 0x%02X)",
+                 ADDR_STR(this->parent_->address_str()), this->handle_cache_.notify_handle,
+                 this->handle_cache_.command_handle, this->handle_cache_.cccd_handle);
+        this->char_notify_handle_ = this->handle_cache_.notify_handle;
+        this->char_command_handle_ = this->handle_cache_.command_handle;
+        this->cccd_pending_ = this->register_for_notify_() && this->write_cccd_();
+        if (!this->cccd_pending_) {
+          this->char_notify_handle_ = 0;
+          this->char_command_handle_ = 0;
+        }
+      }
+      break;
+    }
+    case ESP_GATTC_CFG_MTU_EVT: {
+      if (param->cfg_mtu.status != ESP_GATT_OK) {
+        ESP_LOGW(TAG, "[%s] MTU exchange failed, status=%d", ADDR_STR(this->parent_->address_str()),
+                 param->cfg_mtu.status);
+        break;
+      }
+      ESP_LOGI(TAG, "[%s] MTU: %u (largest response: %u bytes)", ADDR_STR(this->parent_->address_str()),
+               param->cfg_mtu.mtu, MAX_RESPONSE_SIZE);
+      this->publish_state_(this->mtu_sensor_, (float) param->cfg_mtu.mtu);
       break;
     }
     case ESP_GATTC_DISCONNECT_EVT: {
       this->node_state = espbt::ClientState::IDLE;
-
-      this->queue_.reset();
+      this->cccd_pending_ = false;
+      this->reset_link_state_();
 
       if (this->char_notify_handle_ != 0) {
         auto status = esp_ble_gattc_unregister_for_notify(this->parent()->get_gattc_if(),
@@ -246,13 +565,6 @@ void DalyBmsBle::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t g
                  ADDR_STR(this->parent_->address_str()));
         break;
       }
-      this->char_notify_handle_ = char_notify->handle;
-
-      auto status = esp_ble_gattc_register_for_notify(this->parent()->get_gattc_if(), this->parent()->get_remote_bda(),
-                                                      char_notify->handle);
-      if (status) {
-        ESP_LOGW(TAG, "esp_ble_gattc_register_for_notify failed, status=%d", status);
-      }
 
       auto *char_command =
           this->parent_->get_characteristic(DALY_BMS_SERVICE_UUID, DALY_BMS_CONTROL_CHARACTERISTIC_UUID);
@@ -261,68 +573,331 @@ void DalyBmsBle::gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t g
                  ADDR_STR(this->parent_->address_str()));
         break;
       }
+
+      auto *cccd = char_notify->get_descriptor(ESP_GATT_UUID_CHAR_CLIENT_CONFIG);
+      const uint16_t cccd_handle = cccd != nullptr ? cccd->handle : 0;
+      if (this->cache_gatt_handles_ && (char_notify->handle != this->handle_cache_.notify_handle ||
+                                        char_command->handle != this->handle_cache_.command_handle ||
+                                        cccd_handle != this->handle_cache_.cccd_handle)) {
+        if (this->node_state == espbt::ClientState::ESTABLISHED) {
+          ESP_LOGW(TAG, "[%s] Cached handles are stale, restarting with the discovered ones",
+                   ADDR_STR(this->parent_->address_str()));
+          esp_ble_gattc_unregister_for_notify(this->parent()->get_gattc_if(), this->parent()->get_remote_bda(),
+                                              this->char_notify_handle_);
+          this->node_state = espbt::ClientState::CONNECTED;
+          this->queue_.reset();
+          this->invalidate_poll_blocks_();
+        }
+        this->handle_cache_ = {char_notify->handle, char_command->handle, cccd_handle};
+        this->handle_cache_pref_.save(&this->handle_cache_);
+      }
+
+      this->char_notify_handle_ = char_notify->handle;
       this->char_command_handle_ = char_command->handle;
+
+      // Registers again if the cached handles were used, so the BLE client enables notifications via the CCCD.
+      // A CCCD write of the fast path which is still outstanding doesn't hold back polling any longer.
+      this->cccd_pending_ = false;
+      this->register_for_notify_();
       break;
     }
     case ESP_GATTC_REG_FOR_NOTIFY_EVT: {
-      this->node_state = espbt::ClientState::ESTABLISHED;
-      this->update();
+      if (param->reg_for_notify.status != ESP_GATT_OK) {
+        ESP_LOGW(TAG, "[%s] Notification registration failed, status=%d", ADDR_STR(this->parent_->address_str()),
+                 param->reg_for_notify.status);
+        break;
+      }
+      // With cached handles the requests would go out before the notifications are enabled
+      if (this->node_state == espbt::ClientState::ESTABLISHED || this->cccd_pending_)
+        break;
+      this->establish_();
+      break;
+    }
+    case ESP_GATTC_WRITE_DESCR_EVT: {
+      if (!this->cccd_pending_ || param->write.handle != this->handle_cache_.cccd_handle)
+        break;
+      this->cccd_pending_ = false;
+      if (param->write.status != ESP_GATT_OK) {
+        // Service discovery registers for the notifications again and polling starts after all
+        ESP_LOGW(TAG, "[%s] Enabling notifications via the cached CCCD failed, status=%d",
+                 ADDR_STR(this->parent_->address_str()), param->write.status);
+        break;
+      }
+      if (this->node_state != espbt::ClientState::ESTABLISHED)
+        this->establish_();
       break;
     }
     case ESP_GATTC_NOTIFY_EVT: {
       ESP_LOGV(TAG, "Notification received (handle 0x%02X): %s", param->notify.handle,
                format_hex_pretty(param->notify.value, param->notify.value_len).c_str());  // NOLINT
 
-      std::vector<uint8_t> data(param->notify.value, param->notify.value + param->notify.value_len);
-
-      this->on_daly_bms_ble_data(data);
+      this->on_daly_bms_ble_notify(param->notify.value, param->notify.value_len);
       break;
     }
     default:
       break;
   }
 }
-#endif  // USE_ESP32
+
+void DalyBmsBle::gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+  if (event != ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT ||
+      memcmp(param->update_conn_params.bda, this->parent_->get_remote_bda(), sizeof(esp_bd_addr_t)) != 0)
+    return;
+
+  if (param->update_conn_params.status != ESP_BT_STATUS_SUCCESS) {
+    ESP_LOGW(TAG, "[%s] Connection parameter update rejected, status=%d", ADDR_STR(this->parent_->address_str()),
+             param->update_conn_params.status);
+    return;
+  }
+
+  ESP_LOGI(TAG, "[%s] Connection interval: %.2f ms, latency: %u, supervision timeout: %u ms",
+           ADDR_STR(this->parent_->address_str()), param->update_conn_params.conn_int * 1.25f,
+           param->update_conn_params.latency, param->update_conn_params.timeout * 10);
+  this->publish_state_(this->connection_interval_sensor_, param->update_conn_params.conn_int * 1.25f);
+}
+#endif  // USE_DALY_BMS_BLE_TRANSPORT_BLE
+
+void DalyBmsBle::on_transport_connected() {
+  this->connect_millis_ = this->millis_();
+  this->awaiting_first_frame_ = true;
+  this->update();
+}
+
+void DalyBmsBle::on_transport_disconnected() {
+  ESP_LOGW(TAG, "Link to the BMS lost");
+  this->reset_link_state_();
+}
+
+// Everything in flight is lost with the connection, the next one starts with a complete poll cycle
+void DalyBmsBle::reset_link_state_() {
+  this->queue_.reset();
+  this->connection_active_ = false;
+  this->awaiting_first_frame_ = false;
+  this->round_trip_timer_.reset();
+  this->frame_buffer_size_ = 0;
+  this->invalidate_poll_blocks_();
+  this->snapshot_pending_ = 0;
+  this->snapshot_back_().fields = 0;
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+  this->bms_sample_ = {};
+#endif
+}
 
 void DalyBmsBle::loop() {
-  if (this->queue_.timed_out(millis())) {
-    ESP_LOGW(TAG, "Command timeout, advancing queue");
-    this->advance_command_queue_();
+  if (this->transport_ != nullptr)
+    this->transport_->loop();
+
+  const uint32_t now = this->millis_();
+  if (this->queue_.timed_out(now)) {
+    auto &cmd = this->queue_.front();
+    ESP_LOGW(TAG, "Command timeout after %" PRIu32 " ms (addr=0x%04X)", cmd.timeout_ms, cmd.address);
+    this->round_trip_timer_.backoff(cmd.function, cmd.address);
+    this->retry_command_(0, now);
+  }
+
+  if (this->queue_.ready(now))
+    this->send_next_command_();
+}
+
+// Handles a failed attempt of the in-flight command at index (or the next unsent one if index == in_flight).
+// Returns true if the command was kept for another attempt, false if its retry budget is exhausted.
+bool DalyBmsBle::retry_command_(uint8_t index, uint32_t now) {
+  const auto &cmd = this->queue_.at(index);
+  const bool pending = index < this->queue_.in_flight();
+  // The attempt counter of an unsent command is incremented by defer_next_unsent below
+  const uint8_t attempts = cmd.attempts + (pending ? 0 : 1);
+  const uint8_t retries = cmd.function == DALY_FUNCTION_WRITE ? this->write_retries_ : this->read_retries_;
+
+  if (attempts > retries) {
+    ESP_LOGW(TAG, "Giving up on command 0x%02X (addr=0x%04X) after %u attempts", cmd.function, cmd.address, attempts);
+    this->command_failures_++;
+    if (pending) {
+      this->queue_.remove(index);
+    } else {
+      this->queue_.drop_next_unsent();
+    }
+    return false;
   }
+
+  const uint32_t backoff = this->retry_backoff_ << std::min<uint8_t>(attempts - 1, 7);
+  ESP_LOGD(TAG, "Retrying command 0x%02X (addr=0x%04X) in %" PRIu32 " ms (%u/%u)", cmd.function, cmd.address, backoff,
+           attempts, retries);
+  this->command_retries_++;
+  if (pending) {
+    this->queue_.requeue(index, now, backoff);
+  } else {
+    this->queue_.defer_next_unsent(now, backoff);
+  }
+  return true;
 }
 
 void DalyBmsBle::update() {
+  // All values decoded until the next update are published once per heartbeat interval
+  if (this->heartbeat_interval_ != 0) {
+    const uint32_t now = this->millis_();
+    this->heartbeat_due_ = now - this->heartbeat_millis_ >= this->heartbeat_interval_;
+    if (this->heartbeat_due_)
+      this->heartbeat_millis_ = now;
+  }
+
   this->track_online_status_();
-#ifdef USE_ESP32
-  if (this->node_state != espbt::ClientState::ESTABLISHED) {
-    ESP_LOGW(TAG, "[%s] Not connected", ADDR_STR(this->parent_->address_str()));
+  if (this->round_trip_timer_.has_samples())
+    this->publish_state_(this->round_trip_time_sensor_, (float) this->round_trip_timer_.smoothed_rtt_ms());
+  this->publish_state_(this->command_retries_sensor_, (float) this->command_retries_);
+  this->publish_state_(this->command_failures_sensor_, (float) this->command_failures_);
+  this->publish_state_(this->command_successes_sensor_, (float) this->command_successes_);
+  this->publish_state_(this->poll_cycle_overruns_sensor_, (float) this->poll_cycle_overruns_);
+  this->publish_state_(this->skipped_frames_sensor_, (float) this->skipped_frames_);
+  if (!this->is_connected_()) {
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
+    if (this->transport_ == nullptr) {
+      ESP_LOGW(TAG, "[%s] Not connected", ADDR_STR(this->parent_->address_str()));
+      return;
+    }
+#endif
+    ESP_LOGW(TAG, "Not connected");
     return;
   }
 
-  if (this->protocol_version_ == DALY_PROTOCOL_P81) {
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_CELLS_START, DALY_FRAME_LEN_P81_CELLS / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_STATUS_START, DALY_FRAME_LEN_P81_STATUS / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_ALARMS_START, DALY_FRAME_LEN_P81_ALARMS / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_VERSION_START, DALY_FRAME_LEN_P81_VERSION / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_SETTINGS1_START, DALY_FRAME_LEN_P81_SETTINGS1 / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_SETTINGS2_START, DALY_FRAME_LEN_P81_SETTINGS2 / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_SETTINGS3_START, DALY_FRAME_LEN_P81_SETTINGS3 / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_SETTINGS4_START, DALY_FRAME_LEN_P81_SETTINGS4 / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_P81_SETTINGS5_START, DALY_FRAME_LEN_P81_SETTINGS5 / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_BALANCER_SWITCH, DALY_FRAME_LEN_BALANCER_SWITCH / 2);
+  this->queue_poll_blocks_(this->millis_());
+  this->send_next_command_();
+}
+
+void DalyBmsBle::dump_diagnostics() {
+  const BmsSnapshot &snapshot = this->get_snapshot();
+  ESP_LOGI(TAG, "Diagnostics:");
+  ESP_LOGI(TAG, "  Commands: %" PRIu32 " succeeded, %" PRIu32 " retried, %" PRIu32 " failed",
+           this->command_successes_, this->command_retries_, this->command_failures_);
+  ESP_LOGI(TAG, "  Poll cycle overruns: %" PRIu32 ", skipped frames: %" PRIu32, this->poll_cycle_overruns_,
+           this->skipped_frames_);
+  if (this->round_trip_timer_.has_samples())
+    ESP_LOGI(TAG, "  Round trip time: %" PRIu32 " ms", this->round_trip_timer_.smoothed_rtt_ms());
+
+  if (snapshot.fields == 0) {
+    ESP_LOGI(TAG, "  No realtime data received yet");
   } else {
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_STATUS_START, this->status_registers_);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_SETTINGS_START, DALY_FRAME_LEN_SETTINGS / 2);
-    this->queue_command_(DALY_FUNCTION_READ, DALY_COMMAND_REQ_BALANCER_SWITCH, DALY_FRAME_LEN_BALANCER_SWITCH / 2);
+    ESP_LOGI(TAG, "  Snapshot age: %" PRIu32 " ms", this->millis_() - snapshot.millis);
+    ESP_LOGI(TAG, "  Total voltage: %.1f V, current: %.1f A, SOC: %.1f %%", snapshot.total_voltage * 0.1f,
+             (int32_t(snapshot.current) - 30000) * 0.1f, snapshot.state_of_charge * 0.1f);
+    ESP_LOGI(TAG, "  Capacity remaining: %.1f Ah, charging cycles: %u, status: %u",
+             snapshot.capacity_remaining * 0.1f, snapshot.charging_cycles, snapshot.status);
+    ESP_LOGI(TAG, "  MOSFETs: charging %s, discharging %s, balancing %s", ONOFF(snapshot.charging_mosfet != 0),
+             ONOFF(snapshot.discharging_mosfet != 0), ONOFF(snapshot.balancing != 0));
+    if (snapshot.has(BmsSnapshot::ALARMS))
+      ESP_LOGI(TAG, "  Alarms: 0x%016" PRIX64, snapshot.alarms);
+    if (snapshot.has(BmsSnapshot::CELL_VOLTAGES)) {
+      for (uint8_t i = 0; i < snapshot.cell_count; i += 8) {
+        const uint8_t last = std::min<uint8_t>(i + 8, snapshot.cell_count);
+        char line[8 * 6 + 1];
+        size_t pos = 0;
+        for (uint8_t j = i; j < last; j++)
+          pos += snprintf(line + pos, sizeof(line) - pos, " %u", snapshot.cell_voltages[j]);
+        ESP_LOGI(TAG, "  Cells %u-%u:%s mV", i + 1, last, line);
+      }
+    }
+    if (snapshot.has(BmsSnapshot::TEMPERATURES)) {
+      for (uint8_t i = 0; i < snapshot.temperature_probes(); i++)
+        ESP_LOGI(TAG, "  Temperature %u: %d °C", i + 1, int32_t(snapshot.temperatures[i]) - 40);
+    }
+  }
+
+  // The settings are only logged in full on request
+  size_t count;
+  const PollBlock *blocks = poll_blocks(this->is_p81_(), count);
+  for (size_t i = 0; i < count; i++) {
+    if (blocks[i].tier == POLL_TIER_ALARMS || blocks[i].tier == POLL_TIER_SETTINGS) {
+      uint16_t registers = blocks[i].registers != 0 ? blocks[i].registers : this->status_registers_;
+      this->send_command(DALY_FUNCTION_READ, blocks[i].address, registers);
+    }
+  }
+}
+
+void DalyBmsBle::on_daly_bms_ble_notify(const uint8_t *data, uint16_t length) {
+  const uint32_t now = this->millis_();
+  if (this->frame_buffer_size_ > 0 && now - this->frame_buffer_millis_ > this->round_trip_timer_.max_timeout_ms()) {
+    ESP_LOGW(TAG, "Discarding incomplete frame (%u bytes)", this->frame_buffer_size_);
+    this->frame_buffer_size_ = 0;
+  }
+
+  while (length > 0) {
+    // Take only the bytes of the current frame, a complete frame is always at the start of the buffer
+    size_t wanted;
+    if (this->frame_buffer_size_ < 3) {
+      wanted = 3 - this->frame_buffer_size_;
+    } else {
+      wanted = this->expected_frame_length_(this->frame_buffer_[1], this->frame_buffer_[2]) - this->frame_buffer_size_;
+    }
+    size_t chunk = std::min<size_t>(wanted, length);
+    if (this->frame_buffer_size_ == 0)
+      this->frame_buffer_millis_ = now;
+    memcpy(this->frame_buffer_.data() + this->frame_buffer_size_, data, chunk);
+    this->frame_buffer_size_ += chunk;
+    data += chunk;
+    length -= chunk;
+
+    this->process_frame_buffer_();
+  }
+}
+
+uint16_t DalyBmsBle::expected_frame_length_(uint8_t function, uint8_t data_length) const {
+  if (function == DALY_FUNCTION_READ) {
+    uint16_t frame_length = data_length + 5;
+    return (data_length % 2 == 0 && frame_length <= MAX_RESPONSE_SIZE) ? frame_length : 0;
+  }
+  if (function == DALY_FUNCTION_WRITE)
+    return 8;
+  // Modbus exception response: start, function | 0x80, error code, crc
+  if (function == (DALY_FUNCTION_READ | 0x80) || function == (DALY_FUNCTION_WRITE | 0x80))
+    return 5;
+  return 0;
+}
+
+void DalyBmsBle::consume_frame_buffer_(uint8_t length) {
+  this->frame_buffer_size_ -= length;
+  memmove(this->frame_buffer_.data(), this->frame_buffer_.data() + length, this->frame_buffer_size_);
+}
+
+void DalyBmsBle::process_frame_buffer_() {
+  const uint8_t expected_start = this->is_p81_() ? DALY_FRAME_START_P81_RESP : DALY_FRAME_START;
+  const uint8_t *buffer = this->frame_buffer_.data();
+
+  while (this->frame_buffer_size_ > 0) {
+    auto *start = std::find(buffer, buffer + this->frame_buffer_size_, expected_start);
+    if (start != buffer) {
+      ESP_LOGD(TAG, "Skipping %d bytes while waiting for start of frame", (int) (start - buffer));
+      this->consume_frame_buffer_(start - buffer);
+      continue;
+    }
+    if (this->frame_buffer_size_ < 3)
+      return;
+
+    uint16_t frame_len = this->expected_frame_length_(buffer[1], buffer[2]);
+    if (frame_len == 0) {
+      ESP_LOGD(TAG, "Implausible frame header %02X %02X %02X, resyncing", buffer[0], buffer[1], buffer[2]);
+      this->consume_frame_buffer_(1);
+      continue;
+    }
+    if (this->frame_buffer_size_ < frame_len)
+      return;
+
+    uint16_t computed_crc = crc16(buffer, frame_len - 2);
+    uint16_t remote_crc = uint16_t(buffer[frame_len - 2]) | (uint16_t(buffer[frame_len - 1]) << 8);
+    if (computed_crc != remote_crc) {
+      ESP_LOGW(TAG, "CRC check failed! 0x%04X != 0x%04X, resyncing", computed_crc, remote_crc);
+      this->consume_frame_buffer_(1);
+      continue;
+    }
+
+    this->handle_frame_(FrameView(buffer, frame_len));
+    this->consume_frame_buffer_(frame_len);
   }
-  this->send_next_command_();
-#endif
 }
 
-void DalyBmsBle::on_daly_bms_ble_data(const std::vector<uint8_t> &data) {
-  const uint8_t expected_start =
-      this->protocol_version_ == DALY_PROTOCOL_P81 ? DALY_FRAME_START_P81_RESP : DALY_FRAME_START;
-  if (data[0] != expected_start || data.size() > MAX_RESPONSE_SIZE) {
+void DalyBmsBle::on_daly_bms_ble_data(FrameView data) {
+  const uint8_t expected_start = this->is_p81_() ? DALY_FRAME_START_P81_RESP : DALY_FRAME_START;
+  // A write echo carries the register address and value, everything else at least function, length and CRC
+  const bool too_short = data.size() < MIN_RESPONSE_SIZE || (data[1] == DALY_FUNCTION_WRITE && data.size() < 8);
+  if (too_short || data[0] != expected_start || data.size() > MAX_RESPONSE_SIZE) {
     constexpr size_t chunk = 96;
     ESP_LOGW(TAG, "Invalid response received (%zu bytes):", data.size());
     for (size_t i = 0; i < data.size(); i += chunk) {
@@ -340,8 +915,33 @@ void DalyBmsBle::on_daly_bms_ble_data(const std::vector<uint8_t> &data) {
     return;
   }
 
-  uint16_t cmd_address = this->queue_.empty() ? 0xFFFF : this->queue_.front().address;
-  this->advance_command_queue_();
+  this->handle_frame_(data);
+}
+
+void DalyBmsBle::handle_frame_(FrameView data) {
+  if (this->awaiting_first_frame_) {
+    this->awaiting_first_frame_ = false;
+    const uint32_t elapsed = this->millis_() - this->connect_millis_;
+    ESP_LOGD(TAG, "First frame received %" PRIu32 " ms after connect", elapsed);
+    this->publish_state_(this->time_to_first_frame_sensor_, (float) elapsed);
+  }
+
+  uint16_t cmd_address = 0xFFFF;
+  const uint8_t index = this->queue_.match(data.data(), data.size());
+  if (index != CommandQueue::NO_MATCH) {
+    const auto cmd = this->queue_.at(index);
+    this->command_successes_++;
+    // Karn's algorithm: a response to a repeated command can't be attributed to one attempt
+    if (cmd.attempts == 1)
+      this->round_trip_timer_.sample(cmd.function, cmd.address, this->millis_() - cmd.sent_millis);
+    cmd_address = cmd.address;
+    this->queue_.remove(index);
+  } else if (this->queue_.pending()) {
+    // A late or mismatched response must not complete a command which is still waiting for its own
+    ESP_LOGD(TAG, "Response matches no command in flight, dropped");
+    return;
+  }
+  this->send_next_command_();
   this->reset_online_status_tracker_();
 
   if (data[1] == DALY_FUNCTION_WRITE) {
@@ -355,7 +955,11 @@ void DalyBmsBle::on_daly_bms_ble_data(const std::vector<uint8_t> &data) {
     return;
   }
 
-  if (this->protocol_version_ == DALY_PROTOCOL_P81) {
+  if (this->skip_unchanged_frame_(data, cmd_address))
+    return;
+
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+  if (this->is_p81_()) {
     switch (cmd_address) {
       case DALY_COMMAND_REQ_P81_CELLS_START:
         this->decode_p81_cells_data_(data);
@@ -364,25 +968,25 @@ void DalyBmsBle::on_daly_bms_ble_data(const std::vector<uint8_t> &data) {
         this->decode_p81_status_data_(data);
         break;
       case DALY_COMMAND_REQ_P81_ALARMS_START:
-        log_frame_hex(TAG, "[P81] Alarm registers 0x00A4-0x00AD", data);
+        log_frame_hex(TAG, "[P81] Alarm registers 0x00A4-0x00AD", data, this->dump_pending_);
         break;
       case DALY_COMMAND_REQ_P81_VERSION_START:
         this->decode_p81_version_data_(data);
         break;
       case DALY_COMMAND_REQ_P81_SETTINGS1_START:
-        log_frame_hex(TAG, "[P81] Settings registers 0x0100-0x0150", data);
+        log_frame_hex(TAG, "[P81] Settings registers 0x0100-0x0150", data, this->dump_pending_);
         break;
       case DALY_COMMAND_REQ_P81_SETTINGS2_START:
-        log_frame_hex(TAG, "[P81] Settings registers 0x0151-0x0177", data);
+        log_frame_hex(TAG, "[P81] Settings registers 0x0151-0x0177", data, this->dump_pending_);
         break;
       case DALY_COMMAND_REQ_P81_SETTINGS3_START:
-        log_frame_hex(TAG, "[P81] Settings registers 0x01C3-0x0212", data);
+        log_frame_hex(TAG, "[P81] Settings registers 0x01C3-0x0212", data, this->dump_pending_);
         break;
       case DALY_COMMAND_REQ_P81_SETTINGS4_START:
-        log_frame_hex(TAG, "[P81] Settings registers 0x0220-0x022A", data);
+        log_frame_hex(TAG, "[P81] Settings registers 0x0220-0x022A", data, this->dump_pending_);
         break;
       case DALY_COMMAND_REQ_P81_SETTINGS5_START:
-        log_frame_hex(TAG, "[P81] Settings registers 0x024B-0x024C", data);
+        log_frame_hex(TAG, "[P81] Settings registers 0x024B-0x024C", data, this->dump_pending_);
         break;
       case DALY_COMMAND_REQ_BALANCER_SWITCH:
         this->decode_balancer_switch_data_(data);
@@ -393,7 +997,9 @@ void DalyBmsBle::on_daly_bms_ble_data(const std::vector<uint8_t> &data) {
     }
     return;
   }
+#endif
 
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_D2
   switch (cmd_address) {
     case DALY_COMMAND_REQ_STATUS_START:
       this->decode_status_data_(data);
@@ -414,73 +1020,192 @@ void DalyBmsBle::on_daly_bms_ble_data(const std::vector<uint8_t> &data) {
       ESP_LOGW(TAG, "Unhandled response received (addr=0x%04X, len=%zu): %s", cmd_address, data.size(),
                format_hex_pretty(&data.front(), data.size()).c_str());  // NOLINT
   }
+#endif
 }
 
-void DalyBmsBle::decode_status_data_(const std::vector<uint8_t> &data) {
-  auto daly_get_16bit = [&](size_t i) -> uint16_t {
-    return (uint16_t(data[i + 0]) << 8) | (uint16_t(data[i + 1]) << 0);
-  };
-  auto daly_get_32bit = [&](size_t i) -> uint32_t {
-    return (uint32_t(daly_get_16bit(i + 0)) << 16) | (uint32_t(daly_get_16bit(i + 2)) << 0);
+uint64_t DalyBmsBle::get_register_(FrameView data, uint16_t first_address, uint16_t address, uint8_t width) {
+  uint64_t value = 0;
+  size_t i = 3 + (address - first_address) * 2;
+  for (uint8_t j = 0; j < width * 2; j++)
+    value = (value << 8) | data[i + j];
+  return value;
+}
+
+void DalyBmsBle::decode_registers_(FrameView data, uint16_t first_address, const SnapshotRegister *registers,
+                                   size_t count, BmsSnapshot &snapshot) {
+  const uint16_t last_address = first_address + register_count_(data);
+  for (size_t i = 0; i < count; i++) {
+    const SnapshotRegister &reg = registers[i];
+    if (reg.address >= last_address)
+      continue;
+    const uint16_t raw = get_register_(data, first_address, reg.address);
+    snapshot.*reg.value = reg.on_value < 0 ? raw : reg.on_value == 0 ? raw != 0 : raw == reg.on_value;
+    snapshot.fields |= reg.field;
+  }
+}
+
+// Cell voltages start at register 0x0000 in both protocols, the cell count has to be decoded already
+void DalyBmsBle::decode_cell_voltages_(FrameView data, BmsSnapshot &snapshot) {
+  for (uint8_t i = 0; i < snapshot.cell_count; i++)
+    snapshot.cell_voltages[i] = get_register_(data, 0x0000, i);
+  snapshot.fields |= BmsSnapshot::CELL_VOLTAGES;
+}
+
+void DalyBmsBle::decode_temperatures_(FrameView data, uint16_t address, BmsSnapshot &snapshot) {
+  for (uint8_t i = 0; i < snapshot.temperature_probes(); i++)
+    snapshot.temperatures[i] = get_register_(data, 0x0000, address + i);
+  snapshot.fields |= BmsSnapshot::TEMPERATURES;
+}
+
+void DalyBmsBle::complete_snapshot_block_(uint16_t address) {
+  size_t count;
+  const PollBlock *blocks = poll_blocks(this->is_p81_(), count);
+
+  for (size_t i = 0; i < count; i++) {
+    if (blocks[i].address == address)
+      this->snapshot_pending_ &= ~(1 << i);
+  }
+  if (this->snapshot_pending_ == 0)
+    this->commit_snapshot_();
+}
+
+void DalyBmsBle::commit_snapshot_() {
+  this->snapshot_pending_ = 0;
+  if (this->snapshot_back_().fields == 0)
+    return;
+
+  // Readers that started before the swap may have copied from the buffer reused next, they retry
+  const uint32_t sequence = this->snapshot_sequence_.load(std::memory_order_relaxed);
+  this->snapshot_sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  this->snapshot_front_ ^= 1;
+  this->snapshot_back_().fields = 0;
+  this->snapshot_sequence_.store(sequence + 2, std::memory_order_release);
+
+  this->publish_snapshot_(this->get_snapshot());
+}
+
+bool DalyBmsBle::read_snapshot(BmsSnapshot &snapshot, uint8_t attempts) const {
+  for (uint8_t i = 0; i < attempts; i++) {
+    const uint32_t sequence = this->snapshot_sequence_.load(std::memory_order_acquire);
+    if (sequence == 0)
+      return false;
+    if (sequence & 1)
+      continue;
+    snapshot = this->snapshots_[this->snapshot_front_];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->snapshot_sequence_.load(std::memory_order_relaxed) == sequence)
+      return true;
+  }
+  return false;
+}
+
+void DalyBmsBle::publish_snapshot_(const BmsSnapshot &snapshot) {
+  static constexpr SnapshotSensor SENSORS[] = {
+      {&BmsSnapshot::total_voltage, BmsSnapshot::TOTAL_VOLTAGE, 0.1f, 0, &DalyBmsBle::total_voltage_sensor_},
+      {&BmsSnapshot::current, BmsSnapshot::CURRENT, 0.1f, -30000, &DalyBmsBle::current_sensor_, DEADBAND_CURRENT},
+      {&BmsSnapshot::state_of_charge, BmsSnapshot::STATE_OF_CHARGE, 0.1f, 0, &DalyBmsBle::state_of_charge_sensor_,
+       DEADBAND_STATE_OF_CHARGE},
+      {&BmsSnapshot::capacity_remaining, BmsSnapshot::CAPACITY_REMAINING, 0.1f, 0,
+       &DalyBmsBle::capacity_remaining_sensor_},
+      {&BmsSnapshot::cell_count, BmsSnapshot::CELL_COUNT, 1.0f, 0, &DalyBmsBle::cell_count_sensor_},
+      {&BmsSnapshot::temperature_count, BmsSnapshot::TEMPERATURE_COUNT, 1.0f, 0,
+       &DalyBmsBle::temperature_sensors_sensor_},
+      {&BmsSnapshot::charging_cycles, BmsSnapshot::CHARGING_CYCLES, 1.0f, 0, &DalyBmsBle::charging_cycles_sensor_},
+      {&BmsSnapshot::delta_cell_voltage, BmsSnapshot::DELTA_CELL_VOLTAGE, 0.001f, 0,
+       &DalyBmsBle::delta_cell_voltage_sensor_, DEADBAND_CELL_VOLTAGE},
+      {&BmsSnapshot::balance_current, BmsSnapshot::BALANCE_CURRENT, 0.001f, -30000,
+       &DalyBmsBle::balance_current_sensor_, DEADBAND_CURRENT},
+      {&BmsSnapshot::mosfet_temperature, BmsSnapshot::MOSFET_TEMPERATURE, 1.0f, -40,
+       &DalyBmsBle::mosfet_temperature_sensor_, DEADBAND_TEMPERATURE},
+      {&BmsSnapshot::board_temperature, BmsSnapshot::BOARD_TEMPERATURE, 1.0f, -40,
+       &DalyBmsBle::board_temperature_sensor_, DEADBAND_TEMPERATURE},
+      {&BmsSnapshot::max_battery_temperature, BmsSnapshot::MAX_BATTERY_TEMPERATURE, 1.0f, -40,
+       &DalyBmsBle::max_battery_temperature_sensor_, DEADBAND_TEMPERATURE},
+      {&BmsSnapshot::max_battery_temperature_probe, BmsSnapshot::MAX_BATTERY_TEMPERATURE_PROBE, 1.0f, 0,
+       &DalyBmsBle::max_battery_temperature_probe_sensor_},
+      {&BmsSnapshot::min_battery_temperature, BmsSnapshot::MIN_BATTERY_TEMPERATURE, 1.0f, -40,
+       &DalyBmsBle::min_battery_temperature_sensor_, DEADBAND_TEMPERATURE},
+      {&BmsSnapshot::min_battery_temperature_probe, BmsSnapshot::MIN_BATTERY_TEMPERATURE_PROBE, 1.0f, 0,
+       &DalyBmsBle::min_battery_temperature_probe_sensor_},
+      {&BmsSnapshot::energy, BmsSnapshot::ENERGY, 1.0f, 0, &DalyBmsBle::energy_sensor_},
   };
-  auto daly_get_64bit = [&](size_t i) -> uint64_t {
-    return (uint64_t(daly_get_32bit(i + 0)) << 32) | (uint64_t(daly_get_32bit(i + 4)) << 0);
+  static constexpr SnapshotBinarySensor BINARY_SENSORS[] = {
+      {&BmsSnapshot::balancing, BmsSnapshot::BALANCING, &DalyBmsBle::balancing_binary_sensor_},
+      {&BmsSnapshot::charging_mosfet, BmsSnapshot::CHARGING_MOSFET, &DalyBmsBle::charging_binary_sensor_},
+      {&BmsSnapshot::discharging_mosfet, BmsSnapshot::DISCHARGING_MOSFET, &DalyBmsBle::discharging_binary_sensor_},
+      {&BmsSnapshot::precharging_mosfet, BmsSnapshot::PRECHARGING_MOSFET, &DalyBmsBle::precharging_binary_sensor_},
   };
 
-  if (data.size() != DALY_FRAME_LEN_STATUS_62_REGISTERS + 5 && data.size() != DALY_FRAME_LEN_STATUS_80_REGISTERS + 5) {
-    ESP_LOGW(TAG, "decode_status_data_: unexpected frame size %zu", data.size());
-    return;
+  for (const auto &entry : SENSORS) {
+    sensor::Sensor *sensor = this->*entry.sensor;
+    if (sensor == nullptr || !snapshot.has(entry.field))
+      continue;
+    this->publish_state_(sensor, (int32_t(snapshot.*entry.value) + entry.offset) * entry.scale, entry.deadband);
+  }
+  for (const auto &entry : BINARY_SENSORS) {
+    if (snapshot.has(entry.field))
+      this->publish_state_(this->*entry.binary_sensor, snapshot.*entry.value != 0);
   }
-  ESP_LOGI(TAG, "Status frame received (%zu bytes)", data.size());
-  ESP_LOGVV(TAG, "  %s", format_hex_pretty(&data.front(), 100).c_str());                      // NOLINT
-  ESP_LOGVV(TAG, "  %s", format_hex_pretty(&data.front() + 100, data.size() - 100).c_str());  // NOLINT
 
-  // See docs/dalyModbusProtocol.xlsx
-  //
-  // Byte Len Payload              Description                      Unit  Precision
-  //   0   1  0xD2                 Start of frame
-  //   1   1  0x03                 Start of frame
-  //   2   1  0x7C                 Data length
-  //   3   2  0x10 0x1F            Cell voltage 1
-  //   5   2  0x10 0x29            Cell voltage 2
-  //   7   2  0x10 0x33            Cell voltage 3
-  //   9   2  0x10 0x3D            Cell voltage 4
-  //  11   2  0x00 0x00            Cell voltage 5
-  //  13   2  0x00 0x00            Cell voltage 6
-  //  15   2  0x00 0x00            Cell voltage 7
-  //  17   2  0x00 0x00            Cell voltage 8
-  //  19   2  0x00 0x00            Cell voltage 9
-  //  21   2  0x00 0x00            Cell voltage 10
-  //  23   2  0x00 0x00            Cell voltage 11
-  //  25   2  0x00 0x00            Cell voltage 12
-  //  27   2  0x00 0x00            Cell voltage 13
-  //  29   2  0x00 0x00            Cell voltage 14
-  //  31   2  0x00 0x00            Cell voltage 15
-  //  33   2  0x00 0x00            Cell voltage 16
-  //  35   2  0x00 0x00            Cell voltage 17
-  //  37   2  0x00 0x00            Cell voltage 18
-  //  39   2  0x00 0x00            Cell voltage 19
-  //  41   2  0x00 0x00            Cell voltage 20
-  //  43   2  0x00 0x00            Cell voltage 21
-  //  45   2  0x00 0x00            Cell voltage 22
-  //  47   2  0x00 0x00            Cell voltage 23
-  //  49   2  0x00 0x00            Cell voltage 24
-  //  51   2  0x00 0x00            Cell voltage 25
-  //  53   2  0x00 0x00            Cell voltage 26
-  //  55   2  0x00 0x00            Cell voltage 27
-  //  57   2  0x00 0x00            Cell voltage 28
-  //  59   2  0x00 0x00            Cell voltage 29
-  //  61   2  0x00 0x00            Cell voltage 30
-  //  63   2  0x00 0x00            Cell voltage 31
-  //  65   2  0x00 0x00            Cell voltage 32
+#ifdef USE_DALY_BMS_BLE_CELL_VOLTAGES
+  if (snapshot.has(BmsSnapshot::CELL_VOLTAGES))
+    this->publish_cell_voltages_(snapshot);
+#endif
+
+#ifdef USE_DALY_BMS_BLE_TEMPERATURES
+  if (snapshot.has(BmsSnapshot::TEMPERATURES)) {
+    for (uint8_t i = 0; i < snapshot.temperature_probes(); i++) {
+      this->publish_state_(this->temperatures_[i].temperature_sensor_, (int32_t(snapshot.temperatures[i]) - 40) * 1.0f,
+                           DEADBAND_TEMPERATURE);
+    }
+  }
+#endif
+
+#ifdef USE_DALY_BMS_BLE_POWER
+  if (snapshot.has(BmsSnapshot::TOTAL_VOLTAGE | BmsSnapshot::CURRENT) &&
+      (this->power_sensor_ != nullptr || this->charging_power_sensor_ != nullptr ||
+       this->discharging_power_sensor_ != nullptr)) {
+    this->publish_power_(snapshot.total_voltage * 0.1f, (int32_t(snapshot.current) - 30000) * 0.1f);
+  }
+#endif
+
+  // The texts are only looked up or assembled if their code changed
+  auto &codes = this->published_text_codes_;
+  if (snapshot.has(BmsSnapshot::STATUS) && (!codes.status_valid || codes.status != snapshot.status ||
+                                            this->heartbeat_due_)) {
+    codes.status = snapshot.status;
+    codes.status_valid = true;
+    this->publish_state_(this->battery_status_text_sensor_, snapshot.status == 0   ? "Idle"
+                                                            : snapshot.status == 1 ? "Charging"
+                                                            : snapshot.status == 2 ? "Discharging"
+                                                                                   : "Unknown");
+  }
+
+  if (snapshot.has(BmsSnapshot::ALARMS)) {
+    this->publish_state_(this->error_bitmask_sensor_, (float) snapshot.alarms);
+#ifdef USE_DALY_BMS_BLE_ERRORS
+    if (this->errors_text_sensor_ != nullptr &&
+        (!codes.alarms_valid || codes.alarms != snapshot.alarms || this->heartbeat_due_)) {
+      codes.alarms = snapshot.alarms;
+      codes.alarms_valid = true;
+      char errors[ERRORS_TEXT_CAPACITY];
+      size_t length = bitmask_to_text_(ERRORS, ERRORS_SIZE, snapshot.alarms, errors, sizeof(errors));
+      this->publish_state_(this->errors_text_sensor_, errors, length);
+    }
+#endif
+  }
+}
+
+#ifdef USE_DALY_BMS_BLE_CELL_VOLTAGES
+void DalyBmsBle::publish_cell_voltages_(const BmsSnapshot &snapshot) {
   float min_cell_voltage = 100.0f;
   float max_cell_voltage = -100.0f;
   float average_cell_voltage = 0.0f;
   uint8_t min_voltage_cell = 0;
   uint8_t max_voltage_cell = 0;
-  uint8_t cells = std::min(data[102], (uint8_t) 32);
-  for (uint8_t i = 0; i < cells; i++) {
-    float cell_voltage = daly_get_16bit(3 + (i * 2)) * 0.001f;
+  for (uint8_t i = 0; i < snapshot.cell_count; i++) {
+    float cell_voltage = snapshot.cell_voltages[i] * 0.001f;
     average_cell_voltage = average_cell_voltage + cell_voltage;
     if (cell_voltage > 0 && cell_voltage < min_cell_voltage) {
       min_cell_voltage = cell_voltage;
@@ -490,136 +1215,92 @@ void DalyBmsBle::decode_status_data_(const std::vector<uint8_t> &data) {
       max_cell_voltage = cell_voltage;
       max_voltage_cell = i + 1;
     }
-    this->publish_state_(this->cells_[i].cell_voltage_sensor_, cell_voltage);
+    this->publish_state_(this->cells_[i].cell_voltage_sensor_, cell_voltage, DEADBAND_CELL_VOLTAGE);
   }
-  average_cell_voltage = average_cell_voltage / cells;
+  average_cell_voltage = average_cell_voltage / snapshot.cell_count;
 
-  this->publish_state_(this->min_cell_voltage_sensor_, min_cell_voltage);
-  this->publish_state_(this->max_cell_voltage_sensor_, max_cell_voltage);
+  this->publish_state_(this->min_cell_voltage_sensor_, min_cell_voltage, DEADBAND_CELL_VOLTAGE);
+  this->publish_state_(this->max_cell_voltage_sensor_, max_cell_voltage, DEADBAND_CELL_VOLTAGE);
   this->publish_state_(this->max_voltage_cell_sensor_, (float) max_voltage_cell);
   this->publish_state_(this->min_voltage_cell_sensor_, (float) min_voltage_cell);
-  // this->publish_state_(this->delta_cell_voltage_sensor_, max_cell_voltage - min_cell_voltage);
-  this->publish_state_(this->average_cell_voltage_sensor_, average_cell_voltage);
+  this->publish_state_(this->average_cell_voltage_sensor_, average_cell_voltage, DEADBAND_CELL_VOLTAGE);
 
-  //  67   2  0x00 0x3C            Temperature 1    [-40,100] °C
-  //  69   2  0x00 0x3D            Temperature 2
-  //  71   2  0x00 0x3E            Temperature 3
-  //  73   2  0x00 0x3F            Temperature 4
-  //  75   2  0x00 0x00            Temperature 5
-  //  77   2  0x00 0x00            Temperature 6
-  //  79   2  0x00 0x00            Temperature 7
-  //  81   2  0x00 0x00            Temperature 8
-  uint8_t temperature_sensors = std::min(data[104], (uint8_t) 8);
-  this->publish_state_(this->temperature_sensors_sensor_, temperature_sensors);
-  for (uint8_t i = 0; i < temperature_sensors; i++) {
-    this->publish_state_(this->temperatures_[i].temperature_sensor_, (daly_get_16bit(67 + (i * 2)) - 40) * 1.0f);
+  // Without a delta register (P81) the delta is calculated
+  if (!snapshot.has(BmsSnapshot::DELTA_CELL_VOLTAGE)) {
+    this->publish_state_(this->delta_cell_voltage_sensor_, max_cell_voltage - min_cell_voltage,
+                         DEADBAND_CELL_VOLTAGE);
   }
+}
+#endif
 
-  //  83   2  0x00 0x8C            Total voltage
-  float total_voltage = daly_get_16bit(83) * 0.1f;
-  this->publish_state_(this->total_voltage_sensor_, total_voltage);
-
-  //  85   2  0x75 0x4E            Current
-  float current = (daly_get_16bit(85) - 30000) * 0.1f;
-  this->publish_state_(this->current_sensor_, current);
-
-  //  87   2  0x03 0x84            State of charge
-  this->publish_state_(this->state_of_charge_sensor_, daly_get_16bit(87) * 0.1f);
-
-  //  89   2  0x10 0x3D            Max cell voltage
-  ESP_LOGV(TAG, "Max cell voltage: %.3f V", daly_get_16bit(89) * 0.001f);
-
-  //  91   2  0x10 0x1F            Min cell voltage
-  ESP_LOGV(TAG, "Min cell voltage: %.3f V", daly_get_16bit(91) * 0.001f);
-
-  //  93   2  0x00 0x00            Max cell temperature
-  ESP_LOGV(TAG, "Max cell temperature: %.0f °C", (daly_get_16bit(93) - 40) * 1.0f);
-
-  //  95   2  0x00 0x00            Min cell temperature
-  ESP_LOGV(TAG, "Min cell temperature: %.0f °C", (daly_get_16bit(95) - 40) * 1.0f);
-
-  //  97   2  0x00 0x00            Charge/discharge status (0=idle, 1=charging, 2=discharging)
-  this->publish_state_(this->battery_status_text_sensor_, data[98] == 0   ? "Idle"
-                                                          : data[98] == 1 ? "Charging"
-                                                          : data[98] == 2 ? "Discharging"
-                                                                          : "Unknown");
-
-  //  99   2  0x0D 0x80            Capacity remaining
-  this->publish_state_(this->capacity_remaining_sensor_, daly_get_16bit(99) * 0.1f);
-
-  // 101   2  0x00 0x04            Cell count
-  this->publish_state_(this->cell_count_sensor_, daly_get_16bit(101) * 1.0f);
-
-  // 103   2  0x00 0x04            Number of temperature sensors
-  this->publish_state_(this->temperature_sensors_sensor_, daly_get_16bit(103) * 1.0f);
-
-  // 105   2  0x00 0x39            Charging cycles
-  this->publish_state_(this->charging_cycles_sensor_, daly_get_16bit(105) * 1.0f);
-
-  // 107   2  0x00 0x01            Balancer status (0: off, 1: on)
-  this->publish_state_(this->balancing_binary_sensor_, daly_get_16bit(107) == 0x01);
-
-  // 109   2  0x00 0x00            Charging mosfet status (0: off, 1: on)
-  this->publish_state_(this->charging_binary_sensor_, daly_get_16bit(109) == 0x01);
-
-  // 111   2  0x00 0x01            Discharging mosfet status (0: off, 1: on)
-  this->publish_state_(this->discharging_binary_sensor_, daly_get_16bit(111) == 0x01);
-
-  // 113   2  0x10 0x2E            Average cell voltage
-  ESP_LOGV(TAG, "Average cell voltage: %.3f V", daly_get_16bit(113) * 0.001f);
-
-  // 115   2  0x01 0x41            Delta cell voltage
-  this->publish_state_(this->delta_cell_voltage_sensor_, daly_get_16bit(115) * 0.001f);
-
-  // 117   2  0x00 0x2A            Power
-  // Calculate the measurement because the value of the power register is unsigned
-  // float power = daly_get_16bit(117) * 1.0f;
+#ifdef USE_DALY_BMS_BLE_POWER
+// Calculated because the value of the power register is unsigned
+void DalyBmsBle::publish_power_(float total_voltage, float current) {
   float power = total_voltage * current;
   this->publish_state_(this->power_sensor_, power);
   this->publish_state_(this->charging_power_sensor_, std::max(0.0f, power));               // 500W vs 0W -> 500W
   this->publish_state_(this->discharging_power_sensor_, std::abs(std::min(0.0f, power)));  // -500W vs 0W -> 500W
+}
+#endif
 
-  // 119   2  0x00 0x00            Alarm1
-  // 121   2  0x00 0x00            Alarm2
-  // 123   2  0x00 0x00            Alarm3
-  // 125   2  0x00 0x00            Alarm4
-  ESP_LOGVV(TAG, "Alarm bitmask: %llu", daly_get_64bit(119));
-  this->publish_state_(this->error_bitmask_sensor_, daly_get_64bit(119) * 1.0f);
-  this->publish_state_(this->errors_text_sensor_, bitmask_to_string_(ERRORS, ERRORS_SIZE, daly_get_64bit(119)));
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_D2
+void DalyBmsBle::decode_status_data_(FrameView data) {
+  // See docs/dalyModbusProtocol.xlsx, the 80 register frame appends registers 0x003E-0x004F
+  static constexpr SnapshotRegister REGISTERS[] = {
+      {0x0028, &BmsSnapshot::total_voltage, BmsSnapshot::TOTAL_VOLTAGE},
+      {0x0029, &BmsSnapshot::current, BmsSnapshot::CURRENT},
+      {0x002A, &BmsSnapshot::state_of_charge, BmsSnapshot::STATE_OF_CHARGE},
+      {0x002F, &BmsSnapshot::status, BmsSnapshot::STATUS},
+      {0x0030, &BmsSnapshot::capacity_remaining, BmsSnapshot::CAPACITY_REMAINING},
+      {0x0031, &BmsSnapshot::cell_count, BmsSnapshot::CELL_COUNT},
+      {0x0032, &BmsSnapshot::temperature_count, BmsSnapshot::TEMPERATURE_COUNT},
+      {0x0033, &BmsSnapshot::charging_cycles, BmsSnapshot::CHARGING_CYCLES},
+      {0x0034, &BmsSnapshot::balancing, BmsSnapshot::BALANCING, 1},
+      {0x0035, &BmsSnapshot::charging_mosfet, BmsSnapshot::CHARGING_MOSFET, 1},
+      {0x0036, &BmsSnapshot::discharging_mosfet, BmsSnapshot::DISCHARGING_MOSFET, 1},
+      {0x0038, &BmsSnapshot::delta_cell_voltage, BmsSnapshot::DELTA_CELL_VOLTAGE},
+      {0x0040, &BmsSnapshot::balance_current, BmsSnapshot::BALANCE_CURRENT},
+      {0x0042, &BmsSnapshot::mosfet_temperature, BmsSnapshot::MOSFET_TEMPERATURE},
+      {0x0043, &BmsSnapshot::board_temperature, BmsSnapshot::BOARD_TEMPERATURE},
+  };
 
-  if (data.size() == 3 + DALY_FRAME_LEN_STATUS_80_REGISTERS + 2) {
-    // 127   2  0x00 0x00            Cell balance bitmask 1-16
-    // 129   2  0x00 0x00            Cell balance bitmask 17-32
-    ESP_LOGD(TAG, "Cell balance bitmask 1-16:  0x%04X", daly_get_16bit(127));
-    ESP_LOGD(TAG, "Cell balance bitmask 17-32: 0x%04X", daly_get_16bit(129));
+  if (data.size() != DALY_FRAME_LEN_STATUS_62_REGISTERS + 5 && data.size() != DALY_FRAME_LEN_STATUS_80_REGISTERS + 5) {
+    ESP_LOGW(TAG, "decode_status_data_: unexpected frame size %zu", data.size());
+    return;
+  }
+  ESP_LOGV(TAG, "Status frame received (%zu bytes)", data.size());
+  ESP_LOGVV(TAG, "  %s", format_hex_pretty(&data.front(), 100).c_str());                      // NOLINT
+  ESP_LOGVV(TAG, "  %s", format_hex_pretty(&data.front() + 100, data.size() - 100).c_str());  // NOLINT
 
-    // 131   2  0x75 0x30            Balance current (offset -30000, ×0.001)
-    this->publish_state_(this->balance_current_sensor_, (daly_get_16bit(131) - 30000) * 0.001f);
+  auto &snapshot = this->snapshot_back_();
+  snapshot.millis = this->millis_();
+  decode_registers_(data, 0x0000, REGISTERS, snapshot);
 
-    // 133   2  0x00 0x00            Unknown
+  // 0x0000-0x001F  Cell voltage 1-32
+  snapshot.cell_count = std::min<uint16_t>(snapshot.cell_count, 32);
+  decode_cell_voltages_(data, snapshot);
 
-    // 135   2  0x00 0x37            Mosfet temperature (offset -40)
-    this->publish_state_(this->mosfet_temperature_sensor_, (daly_get_16bit(135) - 40) * 1.0f);
+  // 0x0020-0x0027  Temperature 1-8
+  decode_temperatures_(data, 0x0020, snapshot);
 
-    // 137   2  0x00 0x00            Board temperature (offset -40)
-    this->publish_state_(this->board_temperature_sensor_, (daly_get_16bit(137) - 40) * 1.0f);
+  // 0x003A-0x003D  Alarm 1-4
+  snapshot.alarms = get_register_(data, 0x0000, 0x003A, 4);
+  snapshot.fields |= BmsSnapshot::ALARMS;
 
-    // 163   2  CRC
+  if (register_count_(data) == DALY_FRAME_LEN_STATUS_80_REGISTERS / 2) {
+    // 0x003E-0x003F  Cell balance bitmask 1-16, 17-32
+    ESP_LOGV(TAG, "Cell balance bitmask 1-16:  0x%04X", (uint16_t) get_register_(data, 0x0000, 0x003E));
+    ESP_LOGV(TAG, "Cell balance bitmask 17-32: 0x%04X", (uint16_t) get_register_(data, 0x0000, 0x003F));
   }
+
+  this->complete_snapshot_block_(DALY_COMMAND_REQ_STATUS_START);
 }
 
-void DalyBmsBle::decode_settings_data_(const std::vector<uint8_t> &data) {
+static void log_settings(FrameView data) {
   auto daly_get_16bit = [&](size_t i) -> uint16_t {
     return (uint16_t(data[i + 0]) << 8) | (uint16_t(data[i + 1]) << 0);
   };
 
-  if (data.size() != DALY_FRAME_LEN_SETTINGS + 5) {
-    ESP_LOGW(TAG, "decode_settings_data_: unexpected frame size %zu", data.size());
-    return;
-  }
-  ESP_LOGI(TAG, "Settings frame received");
-  ESP_LOGVV(TAG, "  %s", format_hex_pretty(&data.front(), data.size()).c_str());  // NOLINT
-
   // See docs/dalyModbusProtocol.xlsx
   //
   // Byte Len Payload    Register Description                                      Unit  Precision
@@ -740,11 +1421,9 @@ void DalyBmsBle::decode_settings_data_(const std::vector<uint8_t> &data) {
 
   //  77   2  0x00 0x01   0xA5    Charging MOS switch (0: off, 1: on)                     -          1
   ESP_LOGI(TAG, "Charging MOS switch: %s", ONOFF((bool) daly_get_16bit(77)));
-  this->publish_state_(this->charging_switch_, (bool) daly_get_16bit(77));
 
   //  79   2  0x00 0x01   0xA6    Discharge MOS switch (0: off, 1: on)                    -          1
   ESP_LOGI(TAG, "Discharge MOS switch: %s", ONOFF((bool) daly_get_16bit(79)));
-  this->publish_state_(this->discharging_switch_, (bool) daly_get_16bit(79));
 
   //  81   2  0x02 0xA8   0xA7    SOC settings (68.0)                                     %          0.1
   ESP_LOGI(TAG, "SOC settings: %.1f %%", daly_get_16bit(81) * 0.1f);
@@ -753,14 +1432,35 @@ void DalyBmsBle::decode_settings_data_(const std::vector<uint8_t> &data) {
   ESP_LOGI(TAG, "MOS temperature protection alarm: %d °C", daly_get_16bit(83) - 40);
 
   //  85   2  0x7F 0x8B   CRC
+}
+
+void DalyBmsBle::decode_settings_data_(FrameView data) {
+  auto daly_get_16bit = [&](size_t i) -> uint16_t {
+    return (uint16_t(data[i + 0]) << 8) | (uint16_t(data[i + 1]) << 0);
+  };
+
+  if (data.size() != DALY_FRAME_LEN_SETTINGS + 5) {
+    ESP_LOGW(TAG, "decode_settings_data_: unexpected frame size %zu", data.size());
+    return;
+  }
+  ESP_LOGD(TAG, "Settings frame received");
+  ESP_LOGVV(TAG, "  %s", format_hex_pretty(&data.front(), data.size()).c_str());  // NOLINT
+
+  if (this->dump_pending_)
+    log_settings(data);
+
+  // 77: Charging MOS switch, 79: Discharge MOS switch (0: off, 1: on)
+  this->publish_state_(this->charging_switch_, (bool) daly_get_16bit(77));
+  this->publish_state_(this->discharging_switch_, (bool) daly_get_16bit(79));
 
   for (auto &[address, sn] : this->settings_numbers_) {
     uint16_t raw = daly_get_16bit(3 + (address - 0x0080) * 2);
     this->publish_state_(sn.number, (raw - sn.offset) / sn.factor);
   }
 }
+#endif
 
-void DalyBmsBle::decode_balancer_switch_data_(const std::vector<uint8_t> &data) {
+void DalyBmsBle::decode_balancer_switch_data_(FrameView data) {
   if (data.size() != DALY_FRAME_LEN_BALANCER_SWITCH + 5) {
     ESP_LOGW(TAG, "decode_balancer_switch_data_: unexpected frame size %zu", data.size());
     return;
@@ -768,11 +1468,12 @@ void DalyBmsBle::decode_balancer_switch_data_(const std::vector<uint8_t> &data)
   // Frame layout: D2 03 02 [val_hi] [val_lo] [crc_lo] [crc_hi]
   // Byte 3–4: register 0x00CF  (0: off, 1: on)
   bool state = (data[3] << 8 | data[4]) != 0;
-  ESP_LOGI(TAG, "Balancer switch: %s", ONOFF(state));
+  ESP_LOGD(TAG, "Balancer switch: %s", ONOFF(state));
   this->publish_state_(this->balancer_switch_, state);
 }
 
-void DalyBmsBle::decode_version_data_(const std::vector<uint8_t> &data) {
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_D2
+void DalyBmsBle::decode_version_data_(FrameView data) {
   if (data.size() != DALY_FRAME_LEN_VERSIONS + 5) {
     ESP_LOGW(TAG, "decode_version_data_: unexpected frame size %zu", data.size());
     return;
@@ -790,24 +1491,24 @@ void DalyBmsBle::decode_version_data_(const std::vector<uint8_t> &data) {
   //          0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00
   //          0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00
   //          0x00 0x00            Software version
-  auto sw_begin = data.begin() + 3;
-  auto software_version = std::string(sw_begin, std::find(sw_begin, sw_begin + 32, '\0'));
-  ESP_LOGI(TAG, "Software version: %s", software_version.c_str());
-  this->publish_state_(this->software_version_text_sensor_, software_version);
+  const char *software_version = reinterpret_cast<const char *>(data.data() + 3);
+  size_t length = std::find(software_version, software_version + 32, '\0') - software_version;
+  ESP_LOGI(TAG, "Software version: %.*s", (int) length, software_version);
+  this->publish_state_(this->software_version_text_sensor_, software_version, length);
 
   //  35  32  0x42 0x4D 0x53 0x00 0x00 0x00 0x00 0x00 0x00 0x00
   //          0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00
   //          0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00
   //          0x00 0x00            Hardware version
-  auto hw_begin = data.begin() + 35;
-  auto hardware_version = std::string(hw_begin, std::find(hw_begin, hw_begin + 32, '\0'));
-  ESP_LOGI(TAG, "Hardware version: %s", hardware_version.c_str());
-  this->publish_state_(this->hardware_version_text_sensor_, hardware_version);
+  const char *hardware_version = reinterpret_cast<const char *>(data.data() + 35);
+  length = std::find(hardware_version, hardware_version + 32, '\0') - hardware_version;
+  ESP_LOGI(TAG, "Hardware version: %.*s", (int) length, hardware_version);
+  this->publish_state_(this->hardware_version_text_sensor_, hardware_version, length);
 
   //  67   2  0x65 0x13            CRC
 }
 
-void DalyBmsBle::decode_password_data_(const std::vector<uint8_t> &data) {
+void DalyBmsBle::decode_password_data_(FrameView data) {
   if (data.size() != DALY_FRAME_LEN_PASSWORD + 5) {
     ESP_LOGW(TAG, "decode_password_data_: unexpected frame size %zu", data.size());
     return;
@@ -822,13 +1523,33 @@ void DalyBmsBle::decode_password_data_(const std::vector<uint8_t> &data) {
   //   1   1  0x03                 Start of frame
   //   2   1  0x06                 Data length
   //   3   6  0x31 0x32 0x33 0x34 0x35 0x36   Password
-  ESP_LOGI(TAG, "Password: %s", std::string(data.begin() + 3, data.begin() + 3 + 6).c_str());
+  ESP_LOGI(TAG, "Password: %.6s", reinterpret_cast<const char *>(data.data() + 3));
 
   //   9   2  0x4C 0x69            CRC
 }
+#endif
 
 void DalyBmsBle::dump_config() {  // NOLINT(google-readability-function-size,readability-function-size)
   ESP_LOGCONFIG(TAG, "DalyBmsBle:");
+  if (this->transport_ != nullptr)
+    this->transport_->dump_config();
+  ESP_LOGCONFIG(TAG, "  Pipeline depth: %u", this->queue_.depth());
+  ESP_LOGCONFIG(TAG, "  Retries: %u (reads), %u (writes), backoff %" PRIu32 " ms", this->read_retries_,
+                this->write_retries_, this->retry_backoff_);
+  ESP_LOGCONFIG(TAG, "  Alarms update interval: %" PRIu32 " ms", this->alarms_update_interval_);
+  ESP_LOGCONFIG(TAG, "  Settings update interval: %" PRIu32 " ms", this->settings_update_interval_);
+  if (this->mtu_ != 0)
+    ESP_LOGCONFIG(TAG, "  Requested MTU: %u", this->mtu_);
+  if (this->active_connection_interval_ != 0)
+    ESP_LOGCONFIG(TAG, "  Active connection interval: %.2f ms", this->active_connection_interval_ * 1.25f);
+  if (this->idle_connection_interval_ != 0)
+    ESP_LOGCONFIG(TAG, "  Idle connection interval: %.2f ms", this->idle_connection_interval_ * 1.25f);
+  ESP_LOGCONFIG(TAG, "  Cache GATT handles: %s", YESNO(this->cache_gatt_handles_));
+  if (this->heartbeat_interval_ != 0)
+    ESP_LOGCONFIG(TAG, "  Heartbeat interval: %" PRIu32 " ms", this->heartbeat_interval_);
+  ESP_LOGCONFIG(TAG, "  Deadbands: %.3f V, %.1f °C, %.2f A, %.1f %%", this->deadbands_[DEADBAND_CELL_VOLTAGE],
+                this->deadbands_[DEADBAND_TEMPERATURE], this->deadbands_[DEADBAND_CURRENT],
+                this->deadbands_[DEADBAND_STATE_OF_CHARGE]);
 
   LOG_BINARY_SENSOR("", "Online Status", this->online_status_binary_sensor_);
   LOG_BINARY_SENSOR("", "Charging", this->charging_binary_sensor_);
@@ -916,6 +1637,16 @@ void DalyBmsBle::dump_config() {  // NOLINT(google-readability-function-size,rea
   LOG_SENSOR("", "Min battery temperature", this->min_battery_temperature_sensor_);
   LOG_SENSOR("", "Min battery temperature probe", this->min_battery_temperature_probe_sensor_);
   LOG_SENSOR("", "Energy", this->energy_sensor_);
+  LOG_SENSOR("", "Round trip time", this->round_trip_time_sensor_);
+  LOG_SENSOR("", "MTU", this->mtu_sensor_);
+  LOG_SENSOR("", "Connection interval", this->connection_interval_sensor_);
+  LOG_SENSOR("", "Time to first frame", this->time_to_first_frame_sensor_);
+  LOG_SENSOR("", "Command retries", this->command_retries_sensor_);
+  LOG_SENSOR("", "Command failures", this->command_failures_sensor_);
+  LOG_SENSOR("", "Command successes", this->command_successes_sensor_);
+  LOG_SENSOR("", "Poll cycle overruns", this->poll_cycle_overruns_sensor_);
+  LOG_SENSOR("", "Skipped frames", this->skipped_frames_sensor_);
+  LOG_SENSOR("", "BMS sample age", this->bms_sample_age_sensor_);
   LOG_BINARY_SENSOR("", "Precharging", this->precharging_binary_sensor_);
 
   LOG_TEXT_SENSOR("", "Errors", this->errors_text_sensor_);
@@ -965,12 +1696,15 @@ void DalyBmsBle::publish_device_unavailable_() {
   this->publish_state_(this->min_battery_temperature_sensor_, NAN);
   this->publish_state_(this->min_battery_temperature_probe_sensor_, NAN);
   this->publish_state_(this->energy_sensor_, NAN);
+  this->publish_state_(this->round_trip_time_sensor_, NAN);
+  this->publish_state_(this->bms_sample_age_sensor_, NAN);
   for (auto &cell : this->cells_)
     this->publish_state_(cell.cell_voltage_sensor_, NAN);
   for (auto &temp : this->temperatures_)
     this->publish_state_(temp.temperature_sensor_, NAN);
   this->publish_state_(this->battery_status_text_sensor_, "Offline");
   this->publish_state_(this->errors_text_sensor_, "Offline");
+  this->published_text_codes_ = {};
 }
 
 void DalyBmsBle::publish_state_(binary_sensor::BinarySensor *binary_sensor, const bool &state) {
@@ -980,10 +1714,17 @@ void DalyBmsBle::publish_state_(binary_sensor::BinarySensor *binary_sensor, cons
   binary_sensor->publish_state(state);
 }
 
-void DalyBmsBle::publish_state_(sensor::Sensor *sensor, float value) {
+void DalyBmsBle::publish_state_(sensor::Sensor *sensor, float value, Deadband deadband) {
   if (sensor == nullptr)
     return;
 
+  if (!this->heartbeat_due_ && sensor->has_state()) {
+    const float last = sensor->raw_state;
+    if (std::isnan(value) || std::isnan(last) ? std::isnan(value) && std::isnan(last)
+                                              : std::abs(value - last) <= this->deadbands_[deadband])
+      return;
+  }
+
   sensor->publish_state(value);
 }
 
@@ -1001,178 +1742,172 @@ void DalyBmsBle::publish_state_(switch_::Switch *obj, const bool &state) {
   obj->publish_state(state);
 }
 
-void DalyBmsBle::publish_state_(text_sensor::TextSensor *text_sensor, const std::string &state) {
+void DalyBmsBle::publish_state_(text_sensor::TextSensor *text_sensor, const char *state, size_t length) {
   if (text_sensor == nullptr)
     return;
 
-  text_sensor->publish_state(state);
+  // An unchanged text isn't copied into a new string
+  const std::string &last = text_sensor->raw_state;
+  if (!this->heartbeat_due_ && text_sensor->has_state() && last.size() == length &&
+      memcmp(last.data(), state, length) == 0)
+    return;
+
+  text_sensor->publish_state(std::string(state, length));
 }
 
-std::string DalyBmsBle::bitmask_to_string_(const char *const messages[], const uint8_t &messages_size,
-                                           const uint64_t &mask) {
-  std::string values;
-  if (mask) {
-    for (uint8_t i = 0; i < messages_size; i++) {
-      if (mask & (1ULL << i)) {
-        values.append(messages[i]);
-        values.append(";");
-      }
-    }
-    if (!values.empty()) {
-      values.pop_back();
+#ifdef USE_DALY_BMS_BLE_ERRORS
+// Joins the messages of the set bits by ';', messages which don't fit into the buffer anymore are dropped
+size_t DalyBmsBle::bitmask_to_text_(const char *const messages[], uint8_t messages_size, uint64_t mask, char *buffer,
+                                    size_t capacity) {
+  size_t length = 0;
+  bool first = true;
+  for (uint8_t i = 0; i < messages_size; i++) {
+    if (!(mask & (1ULL << i)))
+      continue;
+    const size_t message_length = strlen(messages[i]);
+    if (length + !first + message_length >= capacity) {
+      ESP_LOGW(TAG, "Errors text truncated to %zu characters", length);
+      break;
     }
+    if (!first)
+      buffer[length++] = ';';
+    memcpy(buffer + length, messages[i], message_length);
+    length += message_length;
+    first = false;
+  }
+  buffer[length] = '\0';
+  return length;
+}
+#endif
+
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+bool DalyBmsBle::track_bms_sample_(FrameView data) {
+  const uint32_t now = this->millis_();
+  const uint16_t heartbeat = get_register_(data, 0x0000, 0x003B);
+  auto &sample = this->bms_sample_;
+
+  const bool unchanged = sample.received && heartbeat == sample.heartbeat;
+  if (!unchanged) {
+    sample.advanced |= sample.received;
+    sample.received = true;
+    sample.heartbeat = heartbeat;
+    sample.millis = now;
   }
-  return values;
+  if (!sample.advanced)
+    return false;
+
+  this->publish_state_(this->bms_sample_age_sensor_, (float) (now - sample.millis));
+
+  // Decode anyway if the publish-on-change heartbeat is due
+  sample.stale = unchanged && !this->heartbeat_due_;
+  if (sample.stale)
+    ESP_LOGD(TAG, "[P81] Heartbeat %u unchanged for %" PRIu32 " ms, skipping realtime data", heartbeat,
+             now - sample.millis);
+  return sample.stale;
 }
 
-void DalyBmsBle::decode_p81_cells_data_(const std::vector<uint8_t> &data) {
+void DalyBmsBle::decode_p81_cells_data_(FrameView data) {
+  // Response to realDataCmd00_40: registers 0x0000-0x003F, shifted by +0x10 against D2 after the cell block
+  static constexpr SnapshotRegister REGISTERS[] = {
+      {0x0038, &BmsSnapshot::total_voltage, BmsSnapshot::TOTAL_VOLTAGE},
+      {0x0039, &BmsSnapshot::current, BmsSnapshot::CURRENT},
+      {0x003A, &BmsSnapshot::state_of_charge, BmsSnapshot::STATE_OF_CHARGE},
+      {0x003C, &BmsSnapshot::cell_count, BmsSnapshot::CELL_COUNT},
+      {0x003D, &BmsSnapshot::temperature_count, BmsSnapshot::TEMPERATURE_COUNT},
+  };
+
   if (data.size() != DALY_FRAME_LEN_P81_CELLS + 5) {
     ESP_LOGW(TAG, "decode_p81_cells_data_: unexpected frame size %zu", data.size());
     return;
   }
-  // Response to realDataCmd00_40: registers 0-63
-  // frame: [0x81, 0x03, 0x80, reg0_hi, reg0_lo, reg1_hi, reg1_lo, ..., crc_lo, crc_hi]
-  auto daly_offset_get_16bit = [&](uint8_t reg) -> uint16_t {
-    size_t i = 3 + reg * 2;
-    return (uint16_t(data[i]) << 8) | data[i + 1];
-  };
-
-  uint8_t cells = std::min((uint8_t) daly_offset_get_16bit(0x3C), (uint8_t) 48);        // reg 60 = cell count
-  uint8_t temp_sensors = std::min((uint8_t) daly_offset_get_16bit(0x3D), (uint8_t) 8);  // reg 61 = temp sensor count
 
-  ESP_LOGI(TAG, "[P81] RT1: cells=%u temp_sensors=%u", cells, temp_sensors);
-
-  float min_cell_voltage = 100.0f, max_cell_voltage = -100.0f, avg_cell_voltage = 0.0f;
-  uint8_t min_voltage_cell = 0, max_voltage_cell = 0;
-  for (uint8_t i = 0; i < cells; i++) {
-    float cell_voltage = daly_offset_get_16bit(i) * 0.001f;
-    avg_cell_voltage += cell_voltage;
-    if (cell_voltage > 0.0f && cell_voltage < min_cell_voltage) {
-      min_cell_voltage = cell_voltage;
-      min_voltage_cell = i + 1;
-    }
-    if (cell_voltage > max_cell_voltage) {
-      max_cell_voltage = cell_voltage;
-      max_voltage_cell = i + 1;
-    }
-    this->publish_state_(this->cells_[i].cell_voltage_sensor_, cell_voltage);
+  if (this->track_bms_sample_(data)) {
+    this->complete_snapshot_block_(DALY_COMMAND_REQ_P81_CELLS_START);
+    return;
   }
-  avg_cell_voltage /= cells;
 
-  this->publish_state_(this->min_cell_voltage_sensor_, min_cell_voltage);
-  this->publish_state_(this->max_cell_voltage_sensor_, max_cell_voltage);
-  this->publish_state_(this->average_cell_voltage_sensor_, avg_cell_voltage);
-  this->publish_state_(this->delta_cell_voltage_sensor_, max_cell_voltage - min_cell_voltage);
-  this->publish_state_(this->min_voltage_cell_sensor_, (float) min_voltage_cell);
-  this->publish_state_(this->max_voltage_cell_sensor_, (float) max_voltage_cell);
-  this->publish_state_(this->cell_count_sensor_, (float) cells);
+  auto &snapshot = this->snapshot_back_();
+  snapshot.millis = this->millis_();
+  decode_registers_(data, 0x0000, REGISTERS, snapshot);
+  snapshot.cell_count = std::min<uint16_t>(snapshot.cell_count, 48);
 
+  decode_cell_voltages_(data, snapshot);
   // Temperatures: registers 48-55 (offset -40)
-  this->publish_state_(this->temperature_sensors_sensor_, (float) temp_sensors);
-  for (uint8_t i = 0; i < temp_sensors; i++) {
-    this->publish_state_(this->temperatures_[i].temperature_sensor_, (daly_offset_get_16bit(0x30 + i) - 40) * 1.0f);
-  }
-
-  float total_voltage = daly_offset_get_16bit(0x38) * 0.1f;      // reg 56
-  float current = (daly_offset_get_16bit(0x39) - 30000) * 0.1f;  // reg 57, offset -30000
+  decode_temperatures_(data, 0x0030, snapshot);
 
-  this->publish_state_(this->total_voltage_sensor_, total_voltage);
-  this->publish_state_(this->current_sensor_, current);
-  this->publish_state_(this->state_of_charge_sensor_, daly_offset_get_16bit(0x3A) * 0.1f);  // reg 58
+  ESP_LOGV(TAG, "[P81] RT1: %.1fV  %.1fA  SOC=%.1f%%  cells=%u  temps=%u", snapshot.total_voltage * 0.1f,
+           (int32_t(snapshot.current) - 30000) * 0.1f, snapshot.state_of_charge * 0.1f, snapshot.cell_count,
+           snapshot.temperature_count);
 
-  float power = total_voltage * current;
-  this->publish_state_(this->power_sensor_, power);
-  this->publish_state_(this->charging_power_sensor_, std::max(0.0f, power));
-  this->publish_state_(this->discharging_power_sensor_, std::abs(std::min(0.0f, power)));
-
-  ESP_LOGI(TAG, "[P81] RT1: %.1fV  %.1fA  SOC=%.1f%%  cells=%u  temps=%u  max_cell=%.3fV  min_cell=%.3fV",
-           total_voltage, current, daly_offset_get_16bit(0x3A) * 0.1f, cells, temp_sensors, max_cell_voltage,
-           min_cell_voltage);
+  this->complete_snapshot_block_(DALY_COMMAND_REQ_P81_CELLS_START);
 }
 
-void DalyBmsBle::decode_p81_status_data_(const std::vector<uint8_t> &data) {
+void DalyBmsBle::decode_p81_status_data_(FrameView data) {
+  // Response to realDataCmd41_7E: registers 0x0041-0x007E
+  static constexpr SnapshotRegister REGISTERS[] = {
+      {0x0043, &BmsSnapshot::max_battery_temperature, BmsSnapshot::MAX_BATTERY_TEMPERATURE},
+      {0x0044, &BmsSnapshot::max_battery_temperature_probe, BmsSnapshot::MAX_BATTERY_TEMPERATURE_PROBE},
+      {0x0045, &BmsSnapshot::min_battery_temperature, BmsSnapshot::MIN_BATTERY_TEMPERATURE},
+      {0x0046, &BmsSnapshot::min_battery_temperature_probe, BmsSnapshot::MIN_BATTERY_TEMPERATURE_PROBE},
+      // reg 72: charge/discharge status (0=idle, 1=charging, 2=discharging)
+      {0x0048, &BmsSnapshot::status, BmsSnapshot::STATUS},
+      {0x004B, &BmsSnapshot::capacity_remaining, BmsSnapshot::CAPACITY_REMAINING},
+      {0x004C, &BmsSnapshot::charging_cycles, BmsSnapshot::CHARGING_CYCLES},
+      // 0=off, 1=passive, 2=active
+      {0x004D, &BmsSnapshot::balancing, BmsSnapshot::BALANCING, 0},
+      {0x004E, &BmsSnapshot::balance_current, BmsSnapshot::BALANCE_CURRENT},
+      {0x0052, &BmsSnapshot::charging_mosfet, BmsSnapshot::CHARGING_MOSFET, 1},
+      {0x0053, &BmsSnapshot::discharging_mosfet, BmsSnapshot::DISCHARGING_MOSFET, 1},
+      {0x0054, &BmsSnapshot::precharging_mosfet, BmsSnapshot::PRECHARGING_MOSFET, 1},
+      {0x0059, &BmsSnapshot::energy, BmsSnapshot::ENERGY},
+      {0x005A, &BmsSnapshot::mosfet_temperature, BmsSnapshot::MOSFET_TEMPERATURE},
+      {0x005B, &BmsSnapshot::board_temperature, BmsSnapshot::BOARD_TEMPERATURE},
+  };
+
   if (data.size() != DALY_FRAME_LEN_P81_STATUS + 5) {
     ESP_LOGW(TAG, "decode_p81_status_data_: unexpected frame size %zu", data.size());
     return;
   }
-  // Response to realDataCmd41_7E: registers 65-126
-  auto daly_offset_get_16bit = [&](uint8_t reg) -> uint16_t {
-    size_t i = 3 + (reg - 0x41) * 2;
-    return (uint16_t(data[i]) << 8) | data[i + 1];
-  };
-
-  // reg 72: charge/discharge status (0=idle, 1=charging, 2=discharging)
-  uint16_t status = daly_offset_get_16bit(0x48);
-  this->publish_state_(this->battery_status_text_sensor_, status == 0   ? "Idle"
-                                                          : status == 1 ? "Charging"
-                                                                        : "Discharging");
-
-  // reg 75: remaining capacity (0.1 Ah)
-  this->publish_state_(this->capacity_remaining_sensor_, daly_offset_get_16bit(0x4B) * 0.1f);
-
-  // reg 76: charging cycles
-  this->publish_state_(this->charging_cycles_sensor_, (float) daly_offset_get_16bit(0x4C));
-
-  // reg 77: balancing state (0=off, 1=passive, 2=active)
-  this->publish_state_(this->balancing_binary_sensor_, daly_offset_get_16bit(0x4D) != 0);
-
-  // reg 78: balance current (offset -30000, factor 0.001 A)
-  this->publish_state_(this->balance_current_sensor_, (daly_offset_get_16bit(0x4E) - 30000) * 0.001f);
 
-  // reg 67: max battery temperature (offset -40)
-  this->publish_state_(this->max_battery_temperature_sensor_, (daly_offset_get_16bit(0x43) - 40) * 1.0f);
-
-  // reg 68: max battery temperature probe index
-  this->publish_state_(this->max_battery_temperature_probe_sensor_, (float) daly_offset_get_16bit(0x44));
-
-  // reg 69: min battery temperature (offset -40)
-  this->publish_state_(this->min_battery_temperature_sensor_, (daly_offset_get_16bit(0x45) - 40) * 1.0f);
-
-  // reg 70: min battery temperature probe index
-  this->publish_state_(this->min_battery_temperature_probe_sensor_, (float) daly_offset_get_16bit(0x46));
-
-  // reg 82: charging MOSFET (0=off, 1=on)
-  this->publish_state_(this->charging_binary_sensor_, daly_offset_get_16bit(0x52) == 1);
-
-  // reg 83: discharging MOSFET (0=off, 1=on)
-  this->publish_state_(this->discharging_binary_sensor_, daly_offset_get_16bit(0x53) == 1);
-
-  // reg 84: pre-charge MOSFET (0=off, 1=on)
-  this->publish_state_(this->precharging_binary_sensor_, daly_offset_get_16bit(0x54) == 1);
-
-  // reg 89: energy counter (Wh)
-  this->publish_state_(this->energy_sensor_, (float) daly_offset_get_16bit(0x59));
+  if (this->bms_sample_.stale) {
+    this->bms_sample_.stale = false;
+    this->complete_snapshot_block_(DALY_COMMAND_REQ_P81_STATUS_START);
+    return;
+  }
 
-  // reg 90: MOSFET temperature (offset -40)
-  this->publish_state_(this->mosfet_temperature_sensor_, (daly_offset_get_16bit(0x5A) - 40) * 1.0f);
+  auto &snapshot = this->snapshot_back_();
+  snapshot.millis = this->millis_();
+  decode_registers_(data, 0x0041, REGISTERS, snapshot);
+  // Any other state is reported as discharging
+  snapshot.status = std::min<uint16_t>(snapshot.status, 2);
 
-  // reg 91: board/ambient temperature (offset -40)
-  this->publish_state_(this->board_temperature_sensor_, (daly_offset_get_16bit(0x5B) - 40) * 1.0f);
+  ESP_LOGV(TAG, "[P81] RT2: status=%s  capacity=%.1fAh  cycles=%u  bal=%u  chg_mos=%u  dis_mos=%u  mosfet_temp=%.0f°C",
+           snapshot.status == 0   ? "Idle"
+           : snapshot.status == 1 ? "Charging"
+                                  : "Discharging",
+           snapshot.capacity_remaining * 0.1f, snapshot.charging_cycles, (uint16_t) get_register_(data, 0x0041, 0x4D),
+           snapshot.charging_mosfet, snapshot.discharging_mosfet, (int32_t(snapshot.mosfet_temperature) - 40) * 1.0f);
 
-  ESP_LOGI(TAG, "[P81] RT2: status=%s  capacity=%.1fAh  cycles=%u  bal=%u  chg_mos=%u  dis_mos=%u  mosfet_temp=%.0f°C",
-           status == 0   ? "Idle"
-           : status == 1 ? "Charging"
-                         : "Discharging",
-           daly_offset_get_16bit(0x4B) * 0.1f, daly_offset_get_16bit(0x4C), daly_offset_get_16bit(0x4D),
-           daly_offset_get_16bit(0x52), daly_offset_get_16bit(0x53), (daly_offset_get_16bit(0x5A) - 40) * 1.0f);
+  this->complete_snapshot_block_(DALY_COMMAND_REQ_P81_STATUS_START);
 }
 
-void DalyBmsBle::decode_p81_version_data_(const std::vector<uint8_t> &data) {
+void DalyBmsBle::decode_p81_version_data_(FrameView data) {
   if (data.size() != DALY_FRAME_LEN_P81_VERSION + 5) {
     ESP_LOGW(TAG, "decode_p81_version_data_: unexpected frame size %zu", data.size());
     return;
   }
   // SW version: first 28-byte null-padded field starting at data[3]
   // HW version: next 14-byte null-padded field starting at data[31]
-  auto sw_begin = data.begin() + 3;
-  auto software_version = std::string(sw_begin, std::find(sw_begin, sw_begin + 28, '\0'));
-  ESP_LOGI(TAG, "[P81] Software version: %s", software_version.c_str());
-  this->publish_state_(this->software_version_text_sensor_, software_version);
-
-  auto hw_begin = data.begin() + 31;
-  auto hardware_version = std::string(hw_begin, std::find(hw_begin, hw_begin + 14, '\0'));
-  ESP_LOGI(TAG, "[P81] Hardware version: %s", hardware_version.c_str());
-  this->publish_state_(this->hardware_version_text_sensor_, hardware_version);
+  const char *software_version = reinterpret_cast<const char *>(data.data() + 3);
+  size_t length = std::find(software_version, software_version + 28, '\0') - software_version;
+  ESP_LOGI(TAG, "[P81] Software version: %.*s", (int) length, software_version);
+  this->publish_state_(this->software_version_text_sensor_, software_version, length);
+
+  const char *hardware_version = reinterpret_cast<const char *>(data.data() + 31);
+  length = std::find(hardware_version, hardware_version + 14, '\0') - hardware_version;
+  ESP_LOGI(TAG, "[P81] Hardware version: %.*s", (int) length, hardware_version);
+  this->publish_state_(this->hardware_version_text_sensor_, hardware_version, length);
 }
+#endif
 
 }  // namespace esphome::daly_bms_ble
@@ -1,32 +1,175 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/preferences.h"
 #include "esphome/components/binary_sensor/binary_sensor.h"
 #include "esphome/components/number/number.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/switch/switch.h"
 #include "esphome/components/text_sensor/text_sensor.h"
 #include <map>
+#include <vector>
 
-#ifdef USE_ESP32
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
 #include "esphome/components/ble_client/ble_client.h"
 #include "esphome/components/esp32_ble_tracker/esp32_ble_tracker.h"
+#include <esp_gap_ble_api.h>
+#include <esp_gatt_common_api.h>
 #include <esp_gattc_api.h>
 #endif
 
+// The link to the BMS is selected by codegen: the BLE client (USE_DALY_BMS_BLE_TRANSPORT_BLE), an ESPHome uart
+// (USE_DALY_BMS_BLE_TRANSPORT_UART) or, on the host platform, a TCP endpoint or pty. See daly_transport.h.
+
+// The protocols in use are selected by codegen. Without any (e.g. host tests) both are compiled in.
+#if !defined(USE_DALY_BMS_BLE_PROTOCOL_D2) && !defined(USE_DALY_BMS_BLE_PROTOCOL_P81)
+#define USE_DALY_BMS_BLE_PROTOCOL_D2
+#define USE_DALY_BMS_BLE_PROTOCOL_P81
+#endif
+
+// Publish work is compiled in only for the configured entities, see the platform codegen. The snapshot is
+// always decoded in full. Without USE_DALY_BMS_BLE_ENTITY_FEATURES (e.g. host tests) everything is compiled in.
+#ifndef USE_DALY_BMS_BLE_ENTITY_FEATURES
+#define USE_DALY_BMS_BLE_CELL_VOLTAGES
+#define USE_DALY_BMS_BLE_TEMPERATURES
+#define USE_DALY_BMS_BLE_POWER
+#define USE_DALY_BMS_BLE_ERRORS
+#endif
+
 namespace esphome::daly_bms_ble {
 
-#ifdef USE_ESP32
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
 namespace espbt = esphome::esp32_ble_tracker;
 #endif
 
+// Non-owning view of a received frame
+class FrameView {
+ public:
+  FrameView(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+  FrameView(const std::vector<uint8_t> &data) : data_(data.data()), size_(data.size()) {}  // NOLINT
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const uint8_t &operator[](size_t i) const { return data_[i]; }
+  const uint8_t &front() const { return data_[0]; }
+  const uint8_t *begin() const { return data_; }
+  const uint8_t *end() const { return data_ + size_; }
+
+ protected:
+  const uint8_t *data_;
+  size_t size_;
+};
+
+// Realtime values of one poll cycle as received, in the units of the protocol.
+// Only the values flagged in fields were received, the others are undefined.
+struct BmsSnapshot {
+  enum Field : uint32_t {
+    TOTAL_VOLTAGE = 1 << 0,
+    CURRENT = 1 << 1,
+    STATE_OF_CHARGE = 1 << 2,
+    CAPACITY_REMAINING = 1 << 3,
+    CELL_COUNT = 1 << 4,
+    TEMPERATURE_COUNT = 1 << 5,
+    CHARGING_CYCLES = 1 << 6,
+    STATUS = 1 << 7,
+    DELTA_CELL_VOLTAGE = 1 << 8,
+    ALARMS = 1 << 9,
+    BALANCE_CURRENT = 1 << 10,
+    MOSFET_TEMPERATURE = 1 << 11,
+    BOARD_TEMPERATURE = 1 << 12,
+    MAX_BATTERY_TEMPERATURE = 1 << 13,
+    MAX_BATTERY_TEMPERATURE_PROBE = 1 << 14,
+    MIN_BATTERY_TEMPERATURE = 1 << 15,
+    MIN_BATTERY_TEMPERATURE_PROBE = 1 << 16,
+    ENERGY = 1 << 17,
+    BALANCING = 1 << 18,
+    CHARGING_MOSFET = 1 << 19,
+    DISCHARGING_MOSFET = 1 << 20,
+    PRECHARGING_MOSFET = 1 << 21,
+    CELL_VOLTAGES = 1 << 22,
+    TEMPERATURES = 1 << 23,
+  };
+
+  uint32_t millis;  // receive time of the last frame
+  uint32_t fields;
+  uint16_t total_voltage;       // 0.1 V
+  uint16_t current;             // 0.1 A, offset 30000
+  uint16_t state_of_charge;     // 0.1 %
+  uint16_t capacity_remaining;  // 0.1 Ah
+  uint16_t cell_count;
+  uint16_t temperature_count;
+  uint16_t charging_cycles;
+  uint16_t status;              // 0: idle, 1: charging, 2: discharging
+  uint16_t delta_cell_voltage;  // mV
+  uint16_t balance_current;     // mA, offset 30000
+  uint16_t mosfet_temperature;  // °C, offset 40
+  uint16_t board_temperature;   // °C, offset 40
+  uint16_t max_battery_temperature;
+  uint16_t max_battery_temperature_probe;
+  uint16_t min_battery_temperature;
+  uint16_t min_battery_temperature_probe;
+  uint16_t energy;  // Wh
+  uint16_t balancing;
+  uint16_t charging_mosfet;
+  uint16_t discharging_mosfet;
+  uint16_t precharging_mosfet;
+  uint64_t alarms;
+  uint16_t cell_voltages[48];  // mV
+  uint16_t temperatures[8];    // °C, offset 40
+
+  bool has(uint32_t field) const { return (this->fields & field) == field; }
+  // A BMS may report more probes than registers exist for, only the first 8 are decoded
+  uint8_t temperature_probes() const { return std::min<uint16_t>(this->temperature_count, 8); }
+};
+
+class DalyBmsBle;
+
+// Link to the BMS other than the built-in BLE client. The protocol engine writes request frames and the
+// transport hands the received bytes to DalyBmsBle::on_daly_bms_ble_notify() in whatever chunks they arrive.
+// BLE is not an implementation of this interface: the GATT client, the handle cache and the connection
+// parameters stay part of DalyBmsBle and are used only while no transport is set.
+class DalyBmsTransport {
+ public:
+  virtual ~DalyBmsTransport() = default;
+  void set_engine(DalyBmsBle *engine) { this->engine_ = engine; }
+  // Called from the loop of the component before its timeouts are checked
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual bool is_connected() const = 0;
+  // Returns false if the request couldn't be sent, the attempt then counts as failed
+  virtual bool write_frame(const uint8_t *data, size_t length) = 0;
+
+ protected:
+  // Time source of the engine, virtual in the host tests
+  uint32_t millis_() const;
+
+  DalyBmsBle *engine_{nullptr};
+};
+
+// Time source of the component, the host tests advance a virtual clock instead of the platform one
+class DalyBmsClock {
+ public:
+  virtual ~DalyBmsClock() = default;
+  virtual uint32_t millis() const = 0;
+};
+
 class DalyBmsBle :
-#ifdef USE_ESP32
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
     public esphome::ble_client::BLEClientNode,
 #endif
     public PollingComponent {
  public:
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
+  void setup() override;
+#endif
   void dump_config() override;
   void update() override;
   void loop() override;
@@ -106,6 +249,16 @@ class DalyBmsBle :
   void set_min_battery_temperature_sensor(sensor::Sensor *s) { min_battery_temperature_sensor_ = s; }
   void set_min_battery_temperature_probe_sensor(sensor::Sensor *s) { min_battery_temperature_probe_sensor_ = s; }
   void set_energy_sensor(sensor::Sensor *s) { energy_sensor_ = s; }
+  void set_round_trip_time_sensor(sensor::Sensor *s) { round_trip_time_sensor_ = s; }
+  void set_mtu_sensor(sensor::Sensor *s) { mtu_sensor_ = s; }
+  void set_connection_interval_sensor(sensor::Sensor *s) { connection_interval_sensor_ = s; }
+  void set_time_to_first_frame_sensor(sensor::Sensor *s) { time_to_first_frame_sensor_ = s; }
+  void set_command_retries_sensor(sensor::Sensor *s) { command_retries_sensor_ = s; }
+  void set_command_failures_sensor(sensor::Sensor *s) { command_failures_sensor_ = s; }
+  void set_command_successes_sensor(sensor::Sensor *s) { command_successes_sensor_ = s; }
+  void set_poll_cycle_overruns_sensor(sensor::Sensor *s) { poll_cycle_overruns_sensor_ = s; }
+  void set_skipped_frames_sensor(sensor::Sensor *s) { skipped_frames_sensor_ = s; }
+  void set_bms_sample_age_sensor(sensor::Sensor *s) { bms_sample_age_sensor_ = s; }
   void set_precharging_binary_sensor(binary_sensor::BinarySensor *s) { precharging_binary_sensor_ = s; }
 
   void set_battery_status_text_sensor(text_sensor::TextSensor *battery_status_text_sensor) {
@@ -123,19 +276,58 @@ class DalyBmsBle :
   void set_charging_switch(switch_::Switch *charging_switch) { charging_switch_ = charging_switch; }
   void set_discharging_switch(switch_::Switch *discharging_switch) { discharging_switch_ = discharging_switch; }
   void set_protocol_version(uint8_t protocol_version) { protocol_version_ = protocol_version; }
+  void set_transport(DalyBmsTransport *transport) {
+    this->transport_ = transport;
+    transport->set_engine(this);
+  }
+  void set_clock(DalyBmsClock *clock) { this->clock_ = clock; }
 
   void register_settings_number(uint16_t address, number::Number *number, float factor, float offset) {
     this->settings_numbers_[address] = {number, factor, offset};
   }
   void send_command(uint8_t function, uint16_t address, uint16_t value);
-  void set_response_timeout(uint32_t ms) { queue_.set_timeout_ms(ms); }
-#ifdef USE_ESP32
+  void set_response_timeout(uint32_t ms) { round_trip_timer_.set_max_timeout_ms(ms); }
+  void set_pipeline_depth(uint8_t depth) { queue_.set_depth(depth); }
+  void set_read_retries(uint8_t retries) { this->read_retries_ = retries; }
+  void set_write_retries(uint8_t retries) { this->write_retries_ = retries; }
+  void set_retry_backoff(uint32_t ms) { this->retry_backoff_ = ms; }
+  void set_alarms_update_interval(uint32_t ms) { this->alarms_update_interval_ = ms; }
+  void set_settings_update_interval(uint32_t ms) { this->settings_update_interval_ = ms; }
+  void set_mtu(uint16_t mtu) { this->mtu_ = mtu; }
+  // Connection intervals are given in ms and stored in units of 1.25 ms
+  void set_active_connection_interval(uint32_t ms) { this->active_connection_interval_ = ms * 4 / 5; }
+  void set_idle_connection_interval(uint32_t ms) { this->idle_connection_interval_ = ms * 4 / 5; }
+  void set_cache_gatt_handles(bool cache_gatt_handles) { this->cache_gatt_handles_ = cache_gatt_handles; }
+  void set_cell_voltage_deadband(float deadband) { this->deadbands_[DEADBAND_CELL_VOLTAGE] = deadband; }
+  void set_temperature_deadband(float deadband) { this->deadbands_[DEADBAND_TEMPERATURE] = deadband; }
+  void set_current_deadband(float deadband) { this->deadbands_[DEADBAND_CURRENT] = deadband; }
+  void set_state_of_charge_deadband(float deadband) { this->deadbands_[DEADBAND_STATE_OF_CHARGE] = deadband; }
+  void set_heartbeat_interval(uint32_t ms) { this->heartbeat_interval_ = ms; }
+
+  // Realtime values of the last completed poll cycle, only valid until the next one completes. Check
+  // BmsSnapshot::has() before reading a field: the fields depend on the protocol and status_registers, not on
+  // the configured entities, so cell voltages and temperatures are there without any of their sensors.
+  const BmsSnapshot &get_snapshot() const { return this->snapshots_[this->snapshot_front_]; }
+  // Copies the realtime values of the last completed poll cycle, safe to call from any task.
+  // Returns false if no cycle completed yet or the copy raced with the next one attempts times.
+  bool read_snapshot(BmsSnapshot &snapshot, uint8_t attempts = 4) const;
+  // Logs the last snapshot and the link statistics once and re-reads the settings to log them in full
+  void dump_diagnostics();
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
   void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if,
                            esp_ble_gattc_cb_param_t *param) override;
-  void write_register(uint16_t address, uint16_t value) { send_command(0x06, address, value); }
+  void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) override;
 #endif
+  void write_register(uint16_t address, uint16_t value) { send_command(0x06, address, value); }
+  // Called by transports which establish a connection: starts polling right away
+  void on_transport_connected();
+  // Called by transports when the link went down, drops everything in flight
+  void on_transport_disconnected();
 
-  void on_daly_bms_ble_data(const std::vector<uint8_t> &data);
+  void on_daly_bms_ble_notify(const uint8_t *data, uint16_t length);
+  void on_daly_bms_ble_data(const std::vector<uint8_t> &data) { this->on_daly_bms_ble_data(FrameView(data)); }
+  // Validates a complete frame from outside the reassembly buffer (e.g. the faker configs) and handles it
+  void on_daly_bms_ble_data(FrameView data);
   void set_password(uint32_t password) { this->password_ = password; }
   void set_status_registers(uint8_t protocol_version) { this->status_registers_ = protocol_version; }
 
@@ -170,6 +362,16 @@ class DalyBmsBle :
   sensor::Sensor *min_battery_temperature_sensor_{nullptr};
   sensor::Sensor *min_battery_temperature_probe_sensor_{nullptr};
   sensor::Sensor *energy_sensor_{nullptr};
+  sensor::Sensor *round_trip_time_sensor_{nullptr};
+  sensor::Sensor *mtu_sensor_{nullptr};
+  sensor::Sensor *connection_interval_sensor_{nullptr};
+  sensor::Sensor *time_to_first_frame_sensor_{nullptr};
+  sensor::Sensor *command_retries_sensor_{nullptr};
+  sensor::Sensor *command_failures_sensor_{nullptr};
+  sensor::Sensor *command_successes_sensor_{nullptr};
+  sensor::Sensor *poll_cycle_overruns_sensor_{nullptr};
+  sensor::Sensor *skipped_frames_sensor_{nullptr};
+  sensor::Sensor *bms_sample_age_sensor_{nullptr};
   binary_sensor::BinarySensor *precharging_binary_sensor_{nullptr};
 
   switch_::Switch *balancer_switch_{nullptr};
@@ -198,83 +400,466 @@ class DalyBmsBle :
 
   struct CommandQueue {
     static const size_t LENGTH = 16;
+    static constexpr uint8_t MAX_DEPTH = 8;
+    static constexpr uint8_t FUNCTION_WRITE = 0x06;
+    static constexpr uint8_t NO_MATCH = 0xFF;
+    // The D2 status block is the only read answered with another register count than requested
+    static constexpr uint16_t STATUS_ADDRESS = 0x0000;
+    static bool is_status_length(uint8_t length) { return length == 62 * 2 || length == 80 * 2; }
 
     struct Command {
       uint8_t function;
       uint16_t address;
       uint16_t value;
+      uint32_t sent_millis;  // last attempt
+      uint32_t timeout_ms;
+      uint32_t backoff_ms;  // delay after the last attempt before the command may be sent again
+      uint8_t attempts;
     };
 
-    void set_timeout_ms(uint32_t ms) { timeout_ms_ = ms; }
+    void set_depth(uint8_t depth) { depth_ = std::max<uint8_t>(1, std::min(depth, MAX_DEPTH)); }
+    uint8_t depth() const { return depth_; }
 
+    // Writes are high priority: they are queued ahead of all unsent reads, behind earlier writes
     bool enqueue(uint8_t function, uint16_t address, uint16_t value) {
-      uint8_t next = (tail_ + 1) % LENGTH;
-      if (next == head_)
+      if (full())
         return false;
-      commands_[tail_] = {function, address, value};
-      tail_ = next;
+      uint8_t position = size();
+      if (function == FUNCTION_WRITE) {
+        position = in_flight_;
+        while (position < size() && at(position).function == FUNCTION_WRITE)
+          position++;
+      }
+      for (uint8_t i = size(); i > position; i--)
+        commands_[(head_ + i) % LENGTH] = commands_[(head_ + i - 1) % LENGTH];
+      commands_[(head_ + position) % LENGTH] = {function, address, value, 0, 0, 0, 0};
+      tail_ = (tail_ + 1) % LENGTH;
       return true;
     }
+    // Drops the most recently queued read which hasn't been sent yet to make room for a write
+    bool evict_newest_read(Command &evicted) {
+      for (uint8_t i = size(); i > in_flight_; i--) {
+        if (at(i - 1).function != FUNCTION_WRITE) {
+          evicted = at(i - 1);
+          remove(i - 1);
+          return true;
+        }
+      }
+      return false;
+    }
+    bool contains(uint8_t function, uint16_t address, uint16_t value) const {
+      for (uint8_t i = 0; i < size(); i++) {
+        const Command &cmd = at(i);
+        if (cmd.function == function && cmd.address == address && cmd.value == value)
+          return true;
+      }
+      return false;
+    }
+    bool contains_reads() const {
+      for (uint8_t i = 0; i < size(); i++) {
+        if (at(i).function != FUNCTION_WRITE)
+          return true;
+      }
+      return false;
+    }
     const Command &front() const { return commands_[head_]; }
-    void advance() {
-      if (empty())
+    const Command &at(uint8_t index) const { return commands_[(head_ + index) % LENGTH]; }
+    // The in-flight commands always occupy the first in_flight_ slots, the next one to send follows them
+    bool can_send() const { return in_flight_ < depth_ && in_flight_ < size(); }
+    // A command waiting for its retry backoff blocks the ones behind it to keep the order of writes
+    bool ready(uint32_t now) const {
+      return can_send() && now - next_unsent().sent_millis >= next_unsent().backoff_ms;
+    }
+    const Command &next_unsent() const { return at(in_flight_); }
+    void mark_pending(uint32_t now, uint32_t timeout_ms) {
+      Command &cmd = commands_[(head_ + in_flight_) % LENGTH];
+      cmd.sent_millis = now;
+      cmd.timeout_ms = timeout_ms;
+      cmd.attempts++;
+      in_flight_++;
+    }
+    void drop_next_unsent() { remove(in_flight_); }
+    // Counts a failed send attempt of the next command and holds it back for backoff_ms
+    void defer_next_unsent(uint32_t now, uint32_t backoff_ms) {
+      Command &cmd = commands_[(head_ + in_flight_) % LENGTH];
+      cmd.sent_millis = now;
+      cmd.backoff_ms = backoff_ms;
+      cmd.attempts++;
+    }
+    // Moves an in-flight command back in line as the next one to send, after backoff_ms
+    void requeue(uint8_t index, uint32_t now, uint32_t backoff_ms) {
+      if (index >= in_flight_)
         return;
-      head_ = (head_ + 1) % LENGTH;
-      pending_ = false;
+      Command cmd = at(index);
+      for (uint8_t i = index; i + 1 < in_flight_; i++)
+        commands_[(head_ + i) % LENGTH] = commands_[(head_ + i + 1) % LENGTH];
+      in_flight_--;
+      cmd.sent_millis = now;
+      cmd.backoff_ms = backoff_ms;
+      commands_[(head_ + in_flight_) % LENGTH] = cmd;
+    }
+    // Returns the index of the in-flight command a response belongs to, NO_MATCH if there is none. Reads are
+    // matched by function code and data length (frame[2] == registers * 2), write echoes by function code and
+    // register address. A read answered with another length is attributed to the only read in flight. With
+    // several, a status length (62 or 80 registers) still matches the only status read, the rest is ambiguous.
+    uint8_t match(const uint8_t *frame, size_t size) const {
+      uint8_t reads = 0, read_index = NO_MATCH;
+      uint8_t status_reads = 0, status_index = NO_MATCH;
+      for (uint8_t i = 0; i < in_flight_; i++) {
+        const Command &cmd = at(i);
+        if (cmd.function != frame[1])
+          continue;
+        if (cmd.function == FUNCTION_WRITE && size >= 4 && frame[2] == (cmd.address >> 8) &&
+            frame[3] == (cmd.address & 0xFF))
+          return i;
+        if (cmd.function != FUNCTION_WRITE) {
+          if (frame[2] == uint8_t(cmd.value * 2))
+            return i;
+          reads++;
+          read_index = i;
+          if (cmd.address == STATUS_ADDRESS && is_status_length(uint8_t(cmd.value * 2))) {
+            status_reads++;
+            status_index = i;
+          }
+        }
+      }
+      if (reads == 1)
+        return read_index;
+      return status_reads == 1 && is_status_length(frame[2]) ? status_index : NO_MATCH;
     }
-    void mark_pending(uint32_t now) {
-      pending_ = true;
-      start_millis_ = now;
+    void remove(uint8_t index) {
+      if (index >= size())
+        return;
+      for (uint8_t i = index; i + 1 < size(); i++)
+        commands_[(head_ + i) % LENGTH] = commands_[(head_ + i + 1) % LENGTH];
+      tail_ = (tail_ + LENGTH - 1) % LENGTH;
+      if (index < in_flight_)
+        in_flight_--;
     }
     void reset() {
       head_ = tail_ = 0;
-      pending_ = false;
+      in_flight_ = 0;
     }
     bool empty() const { return head_ == tail_; }
-    bool pending() const { return pending_; }
-    bool timed_out(uint32_t now) const { return pending_ && (now - start_millis_ > timeout_ms_); }
+    bool full() const { return (tail_ + 1) % LENGTH == head_; }
+    bool pending() const { return in_flight_ > 0; }
+    uint8_t in_flight() const { return in_flight_; }
+    // The oldest in-flight command is always the front one
+    bool timed_out(uint32_t now) const { return pending() && (now - front().sent_millis > front().timeout_ms); }
     uint8_t size() const { return (tail_ + LENGTH - head_) % LENGTH; }
 
    private:
     Command commands_[LENGTH];
     uint8_t head_{0};
     uint8_t tail_{0};
-    bool pending_{false};
-    uint32_t start_millis_{0};
-    uint32_t timeout_ms_{3000};
+    uint8_t in_flight_{0};
+    uint8_t depth_{1};
   } queue_;
 
-  void queue_command_(uint8_t function, uint16_t address, uint16_t value);
+  // Smoothed round trip time and variance per command type (Jacobson/Karels, RFC 6298).
+  // The response timeout is derived from them and bounded by the configured response_timeout.
+  struct RoundTripTimer {
+    static const uint8_t SLOTS = 12;
+    static constexpr uint32_t MIN_TIMEOUT_MS = 250;
+
+    struct Estimate {
+      uint8_t function;
+      uint16_t address;
+      uint32_t srtt;    // ms, scaled by 8
+      uint32_t rttvar;  // ms, scaled by 4
+      uint32_t rto;     // ms
+    };
+
+    void set_max_timeout_ms(uint32_t ms) { max_timeout_ms_ = ms; }
+    uint32_t max_timeout_ms() const { return max_timeout_ms_; }
+
+    uint32_t timeout_ms(uint8_t function, uint16_t address) const {
+      const Estimate *estimate = find_(function, address);
+      return estimate != nullptr ? estimate->rto : max_timeout_ms_;
+    }
+    void sample(uint8_t function, uint16_t address, uint32_t rtt) {
+      Estimate *estimate = find_(function, address);
+      if (estimate == nullptr && count_ < SLOTS) {
+        estimate = &estimates_[count_++];
+        *estimate = {function, key_address_(function, address), 0, 0, 0};
+      }
+      if (estimate != nullptr)
+        update_(*estimate, rtt);
+      update_(overall_, rtt);
+      samples_++;
+    }
+    // Exponential backoff after a timeout until the next valid sample
+    void backoff(uint8_t function, uint16_t address) {
+      Estimate *estimate = find_(function, address);
+      if (estimate != nullptr)
+        estimate->rto = std::min(estimate->rto * 2, max_timeout_ms_);
+    }
+    void reset() {
+      count_ = 0;
+      samples_ = 0;
+      overall_ = {};
+    }
+    bool has_samples() const { return samples_ > 0; }
+    uint32_t smoothed_rtt_ms() const { return overall_.srtt >> 3; }
+
+   protected:
+    // All writes share one estimate, reads are tracked per register block
+    static uint16_t key_address_(uint8_t function, uint16_t address) {
+      return function == CommandQueue::FUNCTION_WRITE ? 0xFFFF : address;
+    }
+    const Estimate *find_(uint8_t function, uint16_t address) const {
+      uint16_t key = key_address_(function, address);
+      for (uint8_t i = 0; i < count_; i++) {
+        if (estimates_[i].function == function && estimates_[i].address == key)
+          return &estimates_[i];
+      }
+      return nullptr;
+    }
+    Estimate *find_(uint8_t function, uint16_t address) {
+      return const_cast<Estimate *>(static_cast<const RoundTripTimer *>(this)->find_(function, address));
+    }
+    void update_(Estimate &estimate, uint32_t rtt) {
+      if (estimate.srtt == 0) {
+        estimate.srtt = rtt << 3;
+        estimate.rttvar = rtt << 1;
+      } else {
+        int32_t err = int32_t(rtt) - int32_t(estimate.srtt >> 3);
+        estimate.srtt += err;
+        estimate.rttvar += std::abs(err) - (estimate.rttvar >> 2);
+      }
+      estimate.rto = std::max(MIN_TIMEOUT_MS, std::min((estimate.srtt >> 3) + estimate.rttvar, max_timeout_ms_));
+    }
+
+    Estimate estimates_[SLOTS];
+    Estimate overall_{};
+    uint8_t count_{0};
+    uint32_t samples_{0};
+    uint32_t max_timeout_ms_{3000};
+  } round_trip_timer_;
+
+  // The transports time their reconnects with the clock of the engine
+  friend class DalyBmsTransport;
+  DalyBmsClock *clock_{nullptr};
+  uint32_t millis_() const { return this->clock_ != nullptr ? this->clock_->millis() : millis(); }
+
+  DalyBmsTransport *transport_{nullptr};
+  bool is_connected_() const;
+  void reset_link_state_();
+  bool write_frame_(const uint8_t *data, size_t length);
+
+  bool queue_command_(uint8_t function, uint16_t address, uint16_t value);
   void send_next_command_();
-  void advance_command_queue_();
 
-#ifdef USE_ESP32
+  // Retry budget per command: a failed attempt is repeated after retry_backoff_ * 2^(attempts - 1)
+  uint8_t read_retries_{2};
+  uint8_t write_retries_{5};
+  uint32_t retry_backoff_{100};
+  uint32_t command_retries_{0};
+  uint32_t command_failures_{0};
+  uint32_t command_successes_{0};
+
+  bool retry_command_(uint8_t index, uint32_t now);
+
+  // Poll scheduler: each register block is read at the interval of its tier
+  static const uint8_t MAX_POLL_BLOCKS = 10;
+  uint32_t poll_block_millis_[MAX_POLL_BLOCKS]{};
+  uint16_t poll_block_polled_{0};
+  uint32_t alarms_update_interval_{30000};
+  uint32_t settings_update_interval_{300000};
+  // Poll cycles started while reads of the previous one were still queued
+  uint32_t poll_cycle_overruns_{0};
+
+  // Last response of each block, an identical response is neither decoded nor published again
+  struct PollBlockFrame {
+    uint16_t crc;
+    uint8_t length;  // 0: none received yet
+  } poll_block_frames_[MAX_POLL_BLOCKS]{};
+  uint32_t poll_block_skipped_[MAX_POLL_BLOCKS]{};
+  uint32_t skipped_frames_{0};
+  // Set by a diagnostic dump or an explicit read, the responses to the queued reads are logged in full
+  bool dump_pending_{false};
+
+  void queue_poll_blocks_(uint32_t now);
+  void invalidate_poll_block_(uint16_t address);
+  bool skip_unchanged_frame_(FrameView data, uint16_t address);
+  // Forces a complete poll cycle whose responses are all decoded, e.g. for a new connection
+  void invalidate_poll_blocks_() {
+    this->poll_block_polled_ = 0;
+    for (auto &frame : this->poll_block_frames_)
+      frame.length = 0;
+  }
+
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_BLE
   uint16_t char_notify_handle_{0};
   uint16_t char_command_handle_{0};
+  void request_connection_interval_(bool active);
+
+  // Notify, command and CCCD handles of the last connection, stored per MAC address
+  struct HandleCache {
+    uint16_t notify_handle;
+    uint16_t command_handle;
+    uint16_t cccd_handle;
+  } handle_cache_{0, 0, 0};
+  ESPPreferenceObject handle_cache_pref_;
+  // Set while the notifications are enabled via the cached CCCD handle, polling starts once it's written
+  bool cccd_pending_{false};
+  bool register_for_notify_();
+  bool write_cccd_();
+  void establish_();
 #endif
+  bool cache_gatt_handles_{false};
+
+  // Publish on change: a sensor is only published if its value moved by more than the deadband of its class,
+  // and every heartbeat_interval_ regardless. Without a heartbeat interval unchanged values are never forced.
+  enum Deadband : uint8_t {
+    DEADBAND_NONE,
+    DEADBAND_CELL_VOLTAGE,
+    DEADBAND_TEMPERATURE,
+    DEADBAND_CURRENT,
+    DEADBAND_STATE_OF_CHARGE,
+    DEADBAND_CLASSES,
+  };
+  float deadbands_[DEADBAND_CLASSES]{};
+  uint32_t heartbeat_interval_{0};
+  uint32_t heartbeat_millis_{0};
+  bool heartbeat_due_{false};
+  uint32_t connect_millis_{0};
+  bool awaiting_first_frame_{false};
+  uint16_t mtu_{0};
+  uint16_t active_connection_interval_{0};
+  uint16_t idle_connection_interval_{0};
+  bool connection_active_{false};
+  // Reassembles responses split across several notifications
+  static const uint8_t MAX_RESPONSE_SIZE = 170;
+  std::array<uint8_t, MAX_RESPONSE_SIZE> frame_buffer_;
+  uint8_t frame_buffer_size_{0};
+  uint32_t frame_buffer_millis_{0};
+  static const uint8_t MIN_RESPONSE_SIZE = 5;  // start, function, length and CRC
+  void consume_frame_buffer_(uint8_t length);
+  uint16_t expected_frame_length_(uint8_t function, uint8_t data_length) const;
+  void process_frame_buffer_();
+  // Handles a frame whose start byte, length and CRC have been verified
+  void handle_frame_(FrameView data);
+
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+  // Heartbeat counter of the P81 realtime block, advanced by the BMS with every measurement
+  struct BmsSample {
+    uint16_t heartbeat{0};
+    uint32_t millis{0};  // when the heartbeat advanced last
+    bool received{false};
+    bool advanced{false};  // BMS without a heartbeat counter are never considered stale
+    bool stale{false};     // RT1 repeated the last measurement, skip RT2 of the same cycle as well
+  } bms_sample_;
+  bool track_bms_sample_(FrameView data);
+#endif
+
   uint8_t no_response_count_{0};
   uint32_t password_ = 12345678;
   uint8_t status_registers_{62};
   uint8_t protocol_version_{0xD2};
 
+  // Constant if only one protocol is compiled in, so the branches of the other one are dropped
+#if defined(USE_DALY_BMS_BLE_PROTOCOL_D2) && defined(USE_DALY_BMS_BLE_PROTOCOL_P81)
+  bool is_p81_() const { return this->protocol_version_ == 0x81; }
+#elif defined(USE_DALY_BMS_BLE_PROTOCOL_P81)
+  static constexpr bool is_p81_() { return true; }
+#else
+  static constexpr bool is_p81_() { return false; }
+#endif
+
   std::array<uint8_t, 8> build_frame_(uint8_t function, uint16_t address, uint16_t value) const;
-  void decode_status_data_(const std::vector<uint8_t> &data);
-  void decode_settings_data_(const std::vector<uint8_t> &data);
-  void decode_balancer_switch_data_(const std::vector<uint8_t> &data);
-  void decode_version_data_(const std::vector<uint8_t> &data);
-  void decode_password_data_(const std::vector<uint8_t> &data);
-  void decode_p81_cells_data_(const std::vector<uint8_t> &data);
-  void decode_p81_status_data_(const std::vector<uint8_t> &data);
-  void decode_p81_version_data_(const std::vector<uint8_t> &data);
+
+  // Register descriptors of the realtime blocks, see docs/protocol-register-map.md.
+  // The decoders store the registers in the snapshot, on_value 0 flags any non-zero value.
+  struct SnapshotRegister {
+    uint16_t address;
+    uint16_t BmsSnapshot::*value;
+    BmsSnapshot::Field field;
+    int32_t on_value{-1};  // -1: raw value
+  };
+  // Snapshot values published as sensors: value = (raw + offset) * scale
+  struct SnapshotSensor {
+    uint16_t BmsSnapshot::*value;
+    BmsSnapshot::Field field;
+    float scale;
+    int32_t offset;
+    sensor::Sensor *DalyBmsBle::*sensor;
+    Deadband deadband{DEADBAND_NONE};
+  };
+  struct SnapshotBinarySensor {
+    uint16_t BmsSnapshot::*value;
+    BmsSnapshot::Field field;
+    binary_sensor::BinarySensor *DalyBmsBle::*binary_sensor;
+  };
+  // Number of registers in a read response: [start, function, length, registers..., crc_lo, crc_hi]
+  static uint16_t register_count_(FrameView data) { return (data.size() - 5) / 2; }
+  static uint64_t get_register_(FrameView data, uint16_t first_address, uint16_t address, uint8_t width = 1);
+  static void decode_registers_(FrameView data, uint16_t first_address, const SnapshotRegister *registers,
+                                size_t count, BmsSnapshot &snapshot);
+  template<size_t N>
+  static void decode_registers_(FrameView data, uint16_t first_address, const SnapshotRegister (&registers)[N],
+                                BmsSnapshot &snapshot) {
+    decode_registers_(data, first_address, registers, N, snapshot);
+  }
+  static void decode_cell_voltages_(FrameView data, BmsSnapshot &snapshot);
+  static void decode_temperatures_(FrameView data, uint16_t address, BmsSnapshot &snapshot);
+
+  // Realtime blocks are decoded into the back buffer, which is swapped and published once every realtime
+  // block of the poll cycle has been received
+  BmsSnapshot snapshots_[2]{};
+  uint8_t snapshot_front_{0};
+  // Seqlock of the front buffer for readers in other tasks, odd while the buffers are swapped
+  std::atomic<uint32_t> snapshot_sequence_{0};
+  uint16_t snapshot_pending_{0};  // realtime poll blocks of the cycle still outstanding
+
+  BmsSnapshot &snapshot_back_() { return this->snapshots_[this->snapshot_front_ ^ 1]; }
+  void complete_snapshot_block_(uint16_t address);
+  void commit_snapshot_();
+  void publish_snapshot_(const BmsSnapshot &snapshot);
+#ifdef USE_DALY_BMS_BLE_CELL_VOLTAGES
+  void publish_cell_voltages_(const BmsSnapshot &snapshot);
+#endif
+#ifdef USE_DALY_BMS_BLE_POWER
+  void publish_power_(float total_voltage, float current);
+#endif
+
+  void decode_balancer_switch_data_(FrameView data);
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_D2
+  void decode_status_data_(FrameView data);
+  void decode_settings_data_(FrameView data);
+  void decode_version_data_(FrameView data);
+  void decode_password_data_(FrameView data);
+#endif
+#ifdef USE_DALY_BMS_BLE_PROTOCOL_P81
+  void decode_p81_cells_data_(FrameView data);
+  void decode_p81_status_data_(FrameView data);
+  void decode_p81_version_data_(FrameView data);
+#endif
   void publish_device_unavailable_();
   void reset_online_status_tracker_();
   void track_online_status_();
   void publish_state_(binary_sensor::BinarySensor *binary_sensor, const bool &state);
-  void publish_state_(sensor::Sensor *sensor, float value);
+  void publish_state_(sensor::Sensor *sensor, float value, Deadband deadband = DEADBAND_NONE);
   void publish_state_(number::Number *obj, float value);
   void publish_state_(switch_::Switch *obj, const bool &state);
-  void publish_state_(text_sensor::TextSensor *text_sensor, const std::string &state);
-  std::string bitmask_to_string_(const char *const messages[], const uint8_t &messages_size, const uint64_t &mask);
+  void publish_state_(text_sensor::TextSensor *text_sensor, const char *state, size_t length);
+  void publish_state_(text_sensor::TextSensor *text_sensor, const char *state) {
+    this->publish_state_(text_sensor, state, strlen(state));
+  }
+
+  // Codes behind the battery status and errors texts of the last publication
+  struct TextCodes {
+    uint64_t alarms{0};
+    uint16_t status{0};
+    bool alarms_valid{false};
+    bool status_valid{false};
+  } published_text_codes_;
+#ifdef USE_DALY_BMS_BLE_ERRORS
+  // Home Assistant truncates states to 255 characters
+  static const size_t ERRORS_TEXT_CAPACITY = 256;
+  static size_t bitmask_to_text_(const char *const messages[], uint8_t messages_size, uint64_t mask, char *buffer,
+                                 size_t capacity);
+#endif
 
   bool check_bit_(uint16_t mask, uint16_t flag) { return (mask & flag) == flag; }
 };
@@ -0,0 +1,170 @@
+#include "daly_transport.h"
+#include "esphome/core/log.h"
+
+#ifdef USE_HOST
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace esphome::daly_bms_ble {
+
+static const char *const TAG = "daly_bms_ble.transport";
+
+uint32_t DalyBmsTransport::millis_() const { return this->engine_->millis_(); }
+
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_UART
+void DalyBmsUartTransport::loop() {
+  uint8_t buffer[64];
+  while (this->available() > 0) {
+    const size_t length = std::min<size_t>(this->available(), sizeof(buffer));
+    if (!this->read_array(buffer, length))
+      break;
+    this->engine_->on_daly_bms_ble_notify(buffer, length);
+  }
+}
+
+void DalyBmsUartTransport::dump_config() { ESP_LOGCONFIG(TAG, "  Transport: UART"); }
+
+bool DalyBmsUartTransport::write_frame(const uint8_t *data, size_t length) {
+  // write_array() has no error path, it blocks until the frame fits into the TX buffer of the driver. flush()
+  // doesn't report a result on every supported ESPHome version either, a lost frame ends as a command timeout.
+  this->write_array(data, length);
+  return true;
+}
+#endif  // USE_DALY_BMS_BLE_TRANSPORT_UART
+
+#ifdef USE_HOST
+void DalyBmsHostTransport::loop() {
+  if (this->fd_ < 0) {
+    const uint32_t now = this->millis_();
+    if (this->attempted_ && now - this->attempt_millis_ < RECONNECT_INTERVAL)
+      return;
+    this->attempted_ = true;
+    this->attempt_millis_ = now;
+    const bool tcp = this->device_[0] != '/' && this->device_.find(':') != std::string::npos;
+    if (!(tcp ? this->open_socket_() : this->open_device_()))
+      return;
+  }
+
+  if (this->connecting_) {
+    struct pollfd pfd = {this->fd_, POLLOUT, 0};
+    if (::poll(&pfd, 1, 0) <= 0)
+      return;
+    int error = 0;
+    socklen_t length = sizeof(error);
+    ::getsockopt(this->fd_, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error != 0) {
+      ESP_LOGW(TAG, "Connecting to %s failed: %s", this->device_.c_str(), strerror(error));
+      this->close_();
+      return;
+    }
+    this->connected_();
+  }
+
+  uint8_t buffer[256];
+  while (this->fd_ >= 0) {
+    const ssize_t received = ::read(this->fd_, buffer, sizeof(buffer));
+    if (received > 0) {
+      this->engine_->on_daly_bms_ble_notify(buffer, received);
+      continue;
+    }
+    if (received < 0 && errno == EINTR)
+      continue;
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    // End of stream, or EIO once the other side of a pty is closed
+    ESP_LOGW(TAG, "%s closed", this->device_.c_str());
+    this->close_();
+    this->engine_->on_transport_disconnected();
+  }
+}
+
+void DalyBmsHostTransport::dump_config() { ESP_LOGCONFIG(TAG, "  Transport: %s", this->device_.c_str()); }
+
+bool DalyBmsHostTransport::write_frame(const uint8_t *data, size_t length) {
+  if (!this->is_connected())
+    return false;
+  // No SIGPIPE if the peer closed the connection, the next read reports it
+  const ssize_t sent =
+      this->socket_ ? ::send(this->fd_, data, length, MSG_NOSIGNAL) : ::write(this->fd_, data, length);
+  if (sent < 0) {
+    ESP_LOGW(TAG, "Writing to %s failed: %s", this->device_.c_str(), strerror(errno));
+    return false;
+  }
+  // errno is not set by a short write, the rest of the frame is dropped and the attempt fails
+  if ((size_t) sent < length) {
+    ESP_LOGW(TAG, "Writing to %s stopped after %zd of %zu bytes", this->device_.c_str(), sent, length);
+    return false;
+  }
+  return true;
+}
+
+bool DalyBmsHostTransport::open_socket_() {
+  const size_t separator = this->device_.rfind(':');
+  const std::string host = this->device_.substr(0, separator);
+  const std::string port = this->device_.substr(separator + 1);
+
+  struct addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *addresses = nullptr;
+  const int status = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+  if (status != 0) {
+    ESP_LOGW(TAG, "Resolving %s failed: %s", this->device_.c_str(), gai_strerror(status));
+    return false;
+  }
+
+  // Connects in the background, loop() completes the connection once the socket is writable
+  this->fd_ = ::socket(addresses->ai_family, addresses->ai_socktype | SOCK_NONBLOCK, addresses->ai_protocol);
+  if (this->fd_ >= 0 && ::connect(this->fd_, addresses->ai_addr, addresses->ai_addrlen) != 0 &&
+      errno != EINPROGRESS) {
+    ESP_LOGW(TAG, "Connecting to %s failed: %s", this->device_.c_str(), strerror(errno));
+    this->close_();
+  }
+  ::freeaddrinfo(addresses);
+  if (this->fd_ < 0)
+    return false;
+  this->socket_ = true;
+  this->connecting_ = true;
+  return true;
+}
+
+bool DalyBmsHostTransport::open_device_() {
+  this->fd_ = ::open(this->device_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (this->fd_ < 0) {
+    ESP_LOGW(TAG, "Opening %s failed: %s", this->device_.c_str(), strerror(errno));
+    return false;
+  }
+  // Raw 9600 baud 8N1, a pty ignores the baud rate
+  struct termios tty {};
+  if (::tcgetattr(this->fd_, &tty) == 0) {
+    ::cfmakeraw(&tty);
+    ::cfsetspeed(&tty, B9600);
+    ::tcsetattr(this->fd_, TCSANOW, &tty);
+  }
+  this->socket_ = false;
+  this->connected_();
+  return true;
+}
+
+void DalyBmsHostTransport::close_() {
+  if (this->fd_ >= 0)
+    ::close(this->fd_);
+  this->fd_ = -1;
+  this->connecting_ = false;
+}
+
+void DalyBmsHostTransport::connected_() {
+  this->connecting_ = false;
+  ESP_LOGI(TAG, "Connected to %s", this->device_.c_str());
+  this->engine_->on_transport_connected();
+}
+#endif  // USE_HOST
+
+}  // namespace esphome::daly_bms_ble
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#include "daly_bms_ble.h"
+
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_UART
+#include "esphome/components/uart/uart.h"
+#endif
+
+#ifdef USE_HOST
+#include <string>
+#endif
+
+namespace esphome::daly_bms_ble {
+
+#ifdef USE_DALY_BMS_BLE_TRANSPORT_UART
+// Wired link through the UART/RS485 port of the BMS, 9600 baud 8N1. The port is always considered connected,
+// a missing BMS shows up as command timeouts.
+class DalyBmsUartTransport : public DalyBmsTransport, public uart::UARTDevice {
+ public:
+  void loop() override;
+  void dump_config() override;
+  bool is_connected() const override { return true; }
+  // Always succeeds, the UART component doesn't report write errors
+  bool write_frame(const uint8_t *data, size_t length) override;
+};
+#endif
+
+#ifdef USE_HOST
+// Link of the host platform to a BMS or simulator. A device of the form "host:port" is a TCP endpoint,
+// anything else is opened as a serial device or pty. The link is reopened while it is down.
+class DalyBmsHostTransport : public DalyBmsTransport {
+ public:
+  explicit DalyBmsHostTransport(std::string device) : device_(std::move(device)) {}
+  ~DalyBmsHostTransport() override { this->close_(); }
+
+  void loop() override;
+  void dump_config() override;
+  bool is_connected() const override { return this->fd_ >= 0 && !this->connecting_; }
+  bool write_frame(const uint8_t *data, size_t length) override;
+
+ protected:
+  static const uint32_t RECONNECT_INTERVAL = 5000;
+
+  bool open_socket_();
+  bool open_device_();
+  void close_();
+  void connected_();
+
+  std::string device_;
+  int fd_{-1};
+  bool socket_{false};
+  bool connecting_{false};
+  bool attempted_{false};
+  uint32_t attempt_millis_{0};
+};
+#endif
+
+}  // namespace esphome::daly_bms_ble
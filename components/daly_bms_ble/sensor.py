@@ -7,6 +7,7 @@ from esphome.const import (
     CONF_POWER,
     DEVICE_CLASS_BATTERY,
     DEVICE_CLASS_CURRENT,
+    DEVICE_CLASS_DURATION,
     DEVICE_CLASS_EMPTY,
     DEVICE_CLASS_ENERGY,
     DEVICE_CLASS_POWER,
@@ -19,6 +20,7 @@ from esphome.const import (
     UNIT_AMPERE,
     UNIT_CELSIUS,
     UNIT_EMPTY,
+    UNIT_MILLISECOND,
     UNIT_PERCENT,
     UNIT_VOLT,
     UNIT_WATT,
@@ -54,6 +56,16 @@ CONF_MAX_BATTERY_TEMPERATURE = "max_battery_temperature"
 CONF_MAX_BATTERY_TEMPERATURE_PROBE = "max_battery_temperature_probe"
 CONF_MIN_BATTERY_TEMPERATURE = "min_battery_temperature"
 CONF_MIN_BATTERY_TEMPERATURE_PROBE = "min_battery_temperature_probe"
+CONF_ROUND_TRIP_TIME = "round_trip_time"
+CONF_MTU = "mtu"
+CONF_CONNECTION_INTERVAL = "connection_interval"
+CONF_TIME_TO_FIRST_FRAME = "time_to_first_frame"
+CONF_COMMAND_RETRIES = "command_retries"
+CONF_COMMAND_FAILURES = "command_failures"
+CONF_COMMAND_SUCCESSES = "command_successes"
+CONF_POLL_CYCLE_OVERRUNS = "poll_cycle_overruns"
+CONF_SKIPPED_FRAMES = "skipped_frames"
+CONF_BMS_SAMPLE_AGE = "bms_sample_age"
 
 ICON_CURRENT_DC = "mdi:current-dc"
 ICON_CHARGING_CYCLES = "mdi:battery-sync"
@@ -64,6 +76,16 @@ ICON_MAX_VOLTAGE_CELL = "mdi:battery-plus-outline"
 ICON_ERROR_BITMASK = "mdi:alert-circle-outline"
 ICON_CELL_COUNT = "mdi:car-battery"
 ICON_CAPACITY_REMAINING = "mdi:battery-50"
+ICON_ROUND_TRIP_TIME = "mdi:timer-outline"
+ICON_MTU = "mdi:arrow-expand-horizontal"
+ICON_CONNECTION_INTERVAL = "mdi:bluetooth-connect"
+ICON_TIME_TO_FIRST_FRAME = "mdi:timer-play-outline"
+ICON_COMMAND_RETRIES = "mdi:repeat"
+ICON_COMMAND_FAILURES = "mdi:close-circle-outline"
+ICON_COMMAND_SUCCESSES = "mdi:check-circle-outline"
+ICON_POLL_CYCLE_OVERRUNS = "mdi:timer-alert-outline"
+ICON_SKIPPED_FRAMES = "mdi:content-duplicate"
+ICON_BMS_SAMPLE_AGE = "mdi:timer-sand"
 
 UNIT_AMPERE_HOURS = "Ah"
 
@@ -248,8 +270,97 @@ SENSOR_DEFS = {
         "device_class": DEVICE_CLASS_ENERGY,
         "state_class": STATE_CLASS_TOTAL_INCREASING,
     },
+    CONF_ROUND_TRIP_TIME: {
+        "unit_of_measurement": UNIT_MILLISECOND,
+        "icon": ICON_ROUND_TRIP_TIME,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_DURATION,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+        "state_class": STATE_CLASS_MEASUREMENT,
+    },
+    CONF_MTU: {
+        "unit_of_measurement": UNIT_EMPTY,
+        "icon": ICON_MTU,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_EMPTY,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+    },
+    CONF_CONNECTION_INTERVAL: {
+        "unit_of_measurement": UNIT_MILLISECOND,
+        "icon": ICON_CONNECTION_INTERVAL,
+        "accuracy_decimals": 2,
+        "device_class": DEVICE_CLASS_DURATION,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+    },
+    CONF_TIME_TO_FIRST_FRAME: {
+        "unit_of_measurement": UNIT_MILLISECOND,
+        "icon": ICON_TIME_TO_FIRST_FRAME,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_DURATION,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+    },
+    CONF_COMMAND_RETRIES: {
+        "unit_of_measurement": UNIT_EMPTY,
+        "icon": ICON_COMMAND_RETRIES,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_EMPTY,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+        "state_class": STATE_CLASS_TOTAL_INCREASING,
+    },
+    CONF_COMMAND_FAILURES: {
+        "unit_of_measurement": UNIT_EMPTY,
+        "icon": ICON_COMMAND_FAILURES,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_EMPTY,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+        "state_class": STATE_CLASS_TOTAL_INCREASING,
+    },
+    CONF_COMMAND_SUCCESSES: {
+        "unit_of_measurement": UNIT_EMPTY,
+        "icon": ICON_COMMAND_SUCCESSES,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_EMPTY,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+        "state_class": STATE_CLASS_TOTAL_INCREASING,
+    },
+    CONF_POLL_CYCLE_OVERRUNS: {
+        "unit_of_measurement": UNIT_EMPTY,
+        "icon": ICON_POLL_CYCLE_OVERRUNS,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_EMPTY,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+        "state_class": STATE_CLASS_TOTAL_INCREASING,
+    },
+    CONF_SKIPPED_FRAMES: {
+        "unit_of_measurement": UNIT_EMPTY,
+        "icon": ICON_SKIPPED_FRAMES,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_EMPTY,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+        "state_class": STATE_CLASS_TOTAL_INCREASING,
+    },
+    CONF_BMS_SAMPLE_AGE: {
+        "unit_of_measurement": UNIT_MILLISECOND,
+        "icon": ICON_BMS_SAMPLE_AGE,
+        "accuracy_decimals": 0,
+        "device_class": DEVICE_CLASS_DURATION,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+        "state_class": STATE_CLASS_MEASUREMENT,
+    },
 }
 
+# Sensors which need the publish work of a feature define
+CELL_VOLTAGE_FEATURE_SENSORS = [
+    CONF_MIN_CELL_VOLTAGE,
+    CONF_MAX_CELL_VOLTAGE,
+    CONF_MIN_VOLTAGE_CELL,
+    CONF_MAX_VOLTAGE_CELL,
+    CONF_DELTA_CELL_VOLTAGE,
+    CONF_AVERAGE_CELL_VOLTAGE,
+    *CELLS,
+]
+POWER_FEATURE_SENSORS = [CONF_POWER, CONF_CHARGING_POWER, CONF_DISCHARGING_POWER]
+
 _CELL_VOLTAGE_SCHEMA = sensor.sensor_schema(
     unit_of_measurement=UNIT_VOLT,
     icon=ICON_EMPTY,
@@ -280,6 +391,12 @@ CONFIG_SCHEMA = DALY_BMS_BLE_COMPONENT_SCHEMA.extend(
 
 async def to_code(config):
     hub = await cg.get_variable(config[CONF_DALY_BMS_BLE_ID])
+    if any(key in config for key in CELL_VOLTAGE_FEATURE_SENSORS):
+        cg.add_define("USE_DALY_BMS_BLE_CELL_VOLTAGES")
+    if any(key in config for key in TEMPERATURES):
+        cg.add_define("USE_DALY_BMS_BLE_TEMPERATURES")
+    if any(key in config for key in POWER_FEATURE_SENSORS):
+        cg.add_define("USE_DALY_BMS_BLE_POWER")
     for i, key in enumerate(TEMPERATURES):
         if key in config:
             conf = config[key]
@@ -49,6 +49,8 @@ CONFIG_SCHEMA = DALY_BMS_BLE_COMPONENT_SCHEMA.extend(
 
 async def to_code(config):
     hub = await cg.get_variable(config[CONF_DALY_BMS_BLE_ID])
+    if CONF_ERRORS in config:
+        cg.add_define("USE_DALY_BMS_BLE_ERRORS")
     for key in TEXT_SENSORS:
         if key in config:
             conf = config[key]
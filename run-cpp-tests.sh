@@ -44,5 +44,6 @@ echo "Running C++ unit tests: $COMPONENTS"
 . "$VENV_DIR/bin/activate"
 cd "$ESPHOME_DIR"
 PLATFORMIO_LIBDEPS_DIR=~/.platformio/libdeps \
+DALY_BMS_PDUS_DIR="${DALY_BMS_PDUS_DIR:-$REPO_DIR/docs/pdus}" \
 ASAN_OPTIONS=detect_leaks=0 \
 script/cpp_unit_test.py $COMPONENTS
@@ -0,0 +1,189 @@
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include "../../../components/daly_bms_ble/common.h"
+#include "../../../components/daly_bms_ble/pdus.h"
+
+// Counts heap allocations and their bytes. Replaces the global allocation functions of the benchmark binary.
+static size_t g_allocations = 0;
+static size_t g_allocated_bytes = 0;
+
+static void *counted_malloc(size_t size) {
+  g_allocations++;
+  g_allocated_bytes += size;
+  void *ptr = std::malloc(size != 0 ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new(size_t size) { return counted_malloc(size); }
+void *operator new[](size_t size) { return counted_malloc(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+namespace esphome::daly_bms_ble::testing {
+
+// Reports ns, allocations and allocated bytes per processed frame
+class FrameCounters {
+ public:
+  explicit FrameCounters(benchmark::State &state) : state_(state) {
+    this->allocations_ = g_allocations;
+    this->allocated_bytes_ = g_allocated_bytes;
+  }
+  ~FrameCounters() {
+    const double frames = double(this->state_.iterations()) * this->frames_per_iteration_;
+    this->state_.counters["frames"] = benchmark::Counter(frames, benchmark::Counter::kIsRate);
+    this->state_.counters["allocs/frame"] = double(g_allocations - this->allocations_) / frames;
+    this->state_.counters["bytes/frame"] = double(g_allocated_bytes - this->allocated_bytes_) / frames;
+    this->state_.SetItemsProcessed(int64_t(frames));
+  }
+  void set_frames_per_iteration(size_t frames) { this->frames_per_iteration_ = frames; }
+
+ protected:
+  benchmark::State &state_;
+  size_t allocations_;
+  size_t allocated_bytes_;
+  size_t frames_per_iteration_{1};
+};
+
+// Arg 0: no entities configured, arg 1: all 48 cells and every optional entity
+static std::unique_ptr<ConfiguredBms> make_bms(const benchmark::State &state, uint8_t protocol_version) {
+  auto configured = std::make_unique<ConfiguredBms>(state.range(0) != 0);
+  configured->bms.set_protocol_version(protocol_version);
+  return configured;
+}
+
+// ── Request building and checksums ───────────────────────────────────────────
+
+static void BM_Crc16(benchmark::State &state) {
+  const auto &frame = STATUS_FRAME_80_REG_2;
+  FrameCounters counters(state);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(crc16(frame.data(), frame.size() - 2));
+}
+BENCHMARK(BM_Crc16);
+
+static void BM_BuildFrame(benchmark::State &state) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(state.range(0));
+  FrameCounters counters(state);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(bms.build_frame_(0x03, 0x0080, 41));
+}
+BENCHMARK(BM_BuildFrame)->Arg(0xD2)->Arg(0x81);
+
+static void BM_BitmaskToText(benchmark::State &state) {
+  static const char *const MESSAGES[] = {
+      "Warning: Cell voltage too high",   "Critical: Cell voltage too high",  "Warning: Cell voltage too low",
+      "Critical: Cell voltage too low",   "Warning: Total voltage too high",  "Critical: Total voltage too high",
+      "Warning: Total voltage too low",   "Critical: Total voltage too low",  "Warning: Charging temperature too high",
+      "Critical: Charging temperature too high",
+  };
+  const uint64_t mask = state.range(0) != 0 ? 0x3FF : 0x001;
+  char buffer[256];
+  FrameCounters counters(state);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(TestableDalyBmsBle::bitmask_to_text_(MESSAGES, 10, mask, buffer, sizeof(buffer)));
+}
+BENCHMARK(BM_BitmaskToText)->Arg(0)->Arg(1);
+
+// ── Decoders ─────────────────────────────────────────────────────────────────
+
+#define BENCHMARK_DECODER(name, protocol_version, decoder, frame) \
+  static void name(benchmark::State &state) { \
+    auto configured = make_bms(state, protocol_version); \
+    FrameCounters counters(state); \
+    for (auto _ : state) \
+      configured->bms.decoder(frame); \
+  } \
+  BENCHMARK(name)->Arg(0)->Arg(1)
+
+BENCHMARK_DECODER(BM_DecodeStatus62, 0xD2, decode_status_data_, STATUS_FRAME_62_REG_ALARM_TEMP_DIFF_BOTH);
+BENCHMARK_DECODER(BM_DecodeStatus80, 0xD2, decode_status_data_, STATUS_FRAME_80_REG_2);
+BENCHMARK_DECODER(BM_DecodeSettings, 0xD2, decode_settings_data_, SETTINGS_FRAME_1);
+BENCHMARK_DECODER(BM_DecodeVersion, 0xD2, decode_version_data_, VERSION_FRAME_1);
+BENCHMARK_DECODER(BM_DecodePassword, 0xD2, decode_password_data_, PASSWORD_FRAME_1);
+BENCHMARK_DECODER(BM_DecodeBalancerSwitch, 0xD2, decode_balancer_switch_data_, BALANCER_SWITCH_FRAME_ON);
+BENCHMARK_DECODER(BM_DecodeP81Cells, 0x81, decode_p81_cells_data_, P81_CELLS_FRAME);
+BENCHMARK_DECODER(BM_DecodeP81Status, 0x81, decode_p81_status_data_, P81_STATUS_FRAME);
+BENCHMARK_DECODER(BM_DecodeP81Version, 0x81, decode_p81_version_data_, P81_VERSION_FRAME);
+
+// ── Complete receive path ────────────────────────────────────────────────────
+
+// One read per frame: queued request, response matching, CRC check, decoding and publishing
+static void run_on_data(benchmark::State &state, uint8_t protocol_version, const std::vector<Pdu> &pdus) {
+  auto configured = make_bms(state, protocol_version);
+  FrameCounters counters(state);
+  counters.set_frames_per_iteration(pdus.size());
+  for (auto _ : state) {
+    for (const auto &pdu : pdus) {
+      configured->bms.queue_sent_command_(pdu.function, pdu.address, pdu.value);
+      configured->bms.on_daly_bms_ble_data(pdu.response);
+    }
+  }
+}
+
+// Arg 1 selects the payload size of each notification, 20 bytes is the default ATT MTU
+static void run_on_notify(benchmark::State &state, uint8_t protocol_version, const std::vector<Pdu> &pdus) {
+  auto configured = make_bms(state, protocol_version);
+  const size_t mtu_payload = state.range(1);
+  FrameCounters counters(state);
+  counters.set_frames_per_iteration(pdus.size());
+  for (auto _ : state) {
+    for (const auto &pdu : pdus) {
+      configured->bms.queue_sent_command_(pdu.function, pdu.address, pdu.value);
+      for (size_t i = 0; i < pdu.response.size(); i += mtu_payload)
+        configured->bms.on_daly_bms_ble_notify(pdu.response.data() + i,
+                                               std::min(mtu_payload, pdu.response.size() - i));
+    }
+  }
+}
+
+static const std::vector<Pdu> D2_CYCLE = {
+    {0x03, 0x0000, 80, STATUS_FRAME_80_REG_2},
+    {0x03, 0x0080, 41, SETTINGS_FRAME_1},
+    {0x03, 0x00CF, 1, BALANCER_SWITCH_FRAME_ON},
+};
+static const std::vector<Pdu> P81_CYCLE = {
+    {0x03, 0x0000, 64, P81_CELLS_FRAME},
+    {0x03, 0x0041, 62, P81_STATUS_FRAME},
+    {0x03, 0x00CF, 1, P81_BALANCER_SWITCH_FRAME_ON},
+};
+
+static void BM_OnDataD2Cycle(benchmark::State &state) { run_on_data(state, 0xD2, D2_CYCLE); }
+BENCHMARK(BM_OnDataD2Cycle)->Arg(0)->Arg(1);
+static void BM_OnDataP81Cycle(benchmark::State &state) { run_on_data(state, 0x81, P81_CYCLE); }
+BENCHMARK(BM_OnDataP81Cycle)->Arg(0)->Arg(1);
+static void BM_OnNotifyD2Cycle(benchmark::State &state) { run_on_notify(state, 0xD2, D2_CYCLE); }
+BENCHMARK(BM_OnNotifyD2Cycle)->ArgsProduct({{0, 1}, {20, 244}});
+static void BM_OnNotifyP81Cycle(benchmark::State &state) { run_on_notify(state, 0x81, P81_CYCLE); }
+BENCHMARK(BM_OnNotifyP81Cycle)->ArgsProduct({{0, 1}, {20, 244}});
+
+// ── Captured traffic ─────────────────────────────────────────────────────────
+
+// Replays the captures of docs/pdus, found through DALY_BMS_PDUS_DIR
+static void register_capture(const char *name, const char *file, uint8_t protocol_version) {
+  const std::string dir = pdus_dir();
+  if (dir.empty())
+    return;
+  auto pdus = load_capture(dir + "/" + file);
+  if (pdus.empty())
+    return;
+  benchmark::RegisterBenchmark(name, [pdus = std::move(pdus), protocol_version](benchmark::State &state) {
+    run_on_data(state, protocol_version, pdus);
+  })->Arg(0)->Arg(1);
+}
+
+static const bool CAPTURES_REGISTERED = [] {
+  register_capture("BM_CaptureD2_Btsnoop", "btsnoop_daly_balancer.log", 0xD2);
+  register_capture("BM_CaptureD2_24Cells", "daly_bms_24cells.txt", 0xD2);
+  register_capture("BM_CaptureD2_BlueSeries80Registers", "daly_bms_blue_series_80_registers.txt", 0xD2);
+  register_capture("BM_CaptureP81_EssDlBms", "ess-dl-bms-41_260321_0323.txt", 0x81);
+  return true;
+}();
+
+}  // namespace esphome::daly_bms_ble::testing
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
 #include <vector>
 #include "esphome/components/daly_bms_ble/daly_bms_ble.h"
@@ -13,6 +14,13 @@ struct TestNumber : number::Number {
   void control(float) override {}
 };
 
+// Connected link which swallows every request, the tests feed the responses
+class SinkTransport : public DalyBmsTransport {
+ public:
+  bool is_connected() const override { return true; }
+  bool write_frame(const uint8_t *data, size_t length) override { return true; }
+};
+
 // Exposes protected decoder methods for direct testing.
 class TestableDalyBmsBle : public DalyBmsBle {
  public:
@@ -29,15 +37,169 @@ class TestableDalyBmsBle : public DalyBmsBle {
   using DalyBmsBle::decode_p81_cells_data_;
   using DalyBmsBle::decode_p81_status_data_;
   using DalyBmsBle::decode_p81_version_data_;
+  using DalyBmsBle::bitmask_to_text_;
   using DalyBmsBle::on_daly_bms_ble_data;
 
   using DalyBmsBle::CommandQueue;
+  using DalyBmsBle::RoundTripTimer;
   using DalyBmsBle::queue_command_;
-  using DalyBmsBle::advance_command_queue_;
+  using DalyBmsBle::queue_poll_blocks_;
+  using DalyBmsBle::invalidate_poll_blocks_;
+  using DalyBmsBle::snapshot_back_;
+  using DalyBmsBle::commit_snapshot_;
 
   uint8_t queue_size() const { return queue_.size(); }
+  CommandQueue &get_queue() { return queue_; }
+  RoundTripTimer &get_round_trip_timer() { return round_trip_timer_; }
   bool command_pending() const { return queue_.pending(); }
+  uint32_t get_skipped_frames() const { return skipped_frames_; }
+  uint32_t get_command_retries() const { return command_retries_; }
+  uint32_t get_command_failures() const { return command_failures_; }
+  uint32_t get_command_successes() const { return command_successes_; }
+  uint32_t get_poll_cycle_overruns() const { return poll_cycle_overruns_; }
   void reset_queue() { queue_.reset(); }
+  // Queues a command as if it had been sent over the link, so the next response is attributed to it
+  bool queue_sent_command_(uint8_t function, uint16_t address, uint16_t value) {
+    if (!queue_command_(function, address, value))
+      return false;
+    while (queue_.can_send()) {
+      const auto &cmd = queue_.next_unsent();
+      queue_.mark_pending(millis_(), round_trip_timer_.timeout_ms(cmd.function, cmd.address));
+    }
+    return true;
+  }
+  // Connects the sink link and sends whatever is queued, responses are attributed to the commands sent
+  void connect_sink_link_() {
+    if (transport_ == nullptr)
+      set_transport(&sink_);
+    send_next_command_();
+  }
+
+ protected:
+  SinkTransport sink_;
+};
+
+// Configures every entity the component publishes to, the worst case for each frame
+struct ConfiguredBms {
+  TestableDalyBmsBle bms;
+  sensor::Sensor sensors[35];
+  sensor::Sensor cells[48];
+  sensor::Sensor temperatures[8];
+  binary_sensor::BinarySensor binary_sensors[5];
+  text_sensor::TextSensor text_sensors[4];
+  TestSwitch switches[3];
+  TestNumber numbers[41];
+
+  // Entity names in the order of the arrays above
+  static constexpr const char *SENSOR_NAMES[35] = {
+      "total_voltage",
+      "current",
+      "power",
+      "charging_power",
+      "discharging_power",
+      "error_bitmask",
+      "state_of_charge",
+      "charging_cycles",
+      "min_cell_voltage",
+      "max_cell_voltage",
+      "min_voltage_cell",
+      "max_voltage_cell",
+      "delta_cell_voltage",
+      "average_cell_voltage",
+      "cell_count",
+      "temperature_sensors",
+      "capacity_remaining",
+      "balance_current",
+      "mosfet_temperature",
+      "board_temperature",
+      "max_battery_temperature",
+      "max_battery_temperature_probe",
+      "min_battery_temperature",
+      "min_battery_temperature_probe",
+      "energy",
+      "round_trip_time",
+      "poll_cycle_overruns",
+      "skipped_frames",
+      "mtu",
+      "connection_interval",
+      "time_to_first_frame",
+      "command_retries",
+      "command_failures",
+      "command_successes",
+      "bms_sample_age",
+  };
+  static constexpr const char *BINARY_SENSOR_NAMES[5] = {"online_status", "balancing", "charging", "discharging",
+                                                         "precharging"};
+  static constexpr const char *TEXT_SENSOR_NAMES[4] = {"battery_status", "errors", "software_version",
+                                                       "hardware_version"};
+  static constexpr const char *SWITCH_NAMES[3] = {"balancer", "charging", "discharging"};
+
+  // Without entities only the decoding and the snapshot remain
+  explicit ConfiguredBms(bool with_entities = true) {
+    if (!with_entities)
+      return;
+    sensor::Sensor *s = sensors;
+    bms.set_total_voltage_sensor(s++);
+    bms.set_current_sensor(s++);
+    bms.set_power_sensor(s++);
+    bms.set_charging_power_sensor(s++);
+    bms.set_discharging_power_sensor(s++);
+    bms.set_error_bitmask_sensor(s++);
+    bms.set_state_of_charge_sensor(s++);
+    bms.set_charging_cycles_sensor(s++);
+    bms.set_min_cell_voltage_sensor(s++);
+    bms.set_max_cell_voltage_sensor(s++);
+    bms.set_min_voltage_cell_sensor(s++);
+    bms.set_max_voltage_cell_sensor(s++);
+    bms.set_delta_cell_voltage_sensor(s++);
+    bms.set_average_cell_voltage_sensor(s++);
+    bms.set_cell_count_sensor(s++);
+    bms.set_temperature_sensors_sensor(s++);
+    bms.set_capacity_remaining_sensor(s++);
+    bms.set_balance_current_sensor(s++);
+    bms.set_mosfet_temperature_sensor(s++);
+    bms.set_board_temperature_sensor(s++);
+    bms.set_max_battery_temperature_sensor(s++);
+    bms.set_max_battery_temperature_probe_sensor(s++);
+    bms.set_min_battery_temperature_sensor(s++);
+    bms.set_min_battery_temperature_probe_sensor(s++);
+    bms.set_energy_sensor(s++);
+    bms.set_round_trip_time_sensor(s++);
+    bms.set_poll_cycle_overruns_sensor(s++);
+    bms.set_skipped_frames_sensor(s++);
+    bms.set_mtu_sensor(s++);
+    bms.set_connection_interval_sensor(s++);
+    bms.set_time_to_first_frame_sensor(s++);
+    bms.set_command_retries_sensor(s++);
+    bms.set_command_failures_sensor(s++);
+    bms.set_command_successes_sensor(s++);
+    bms.set_bms_sample_age_sensor(s++);
+    for (uint8_t i = 0; i < 48; i++)
+      bms.set_cell_voltage_sensor(i, &cells[i]);
+    for (uint8_t i = 0; i < 8; i++)
+      bms.set_temperature_sensor(i, &temperatures[i]);
+    bms.set_online_status_binary_sensor(&binary_sensors[0]);
+    bms.set_balancing_binary_sensor(&binary_sensors[1]);
+    bms.set_charging_binary_sensor(&binary_sensors[2]);
+    bms.set_discharging_binary_sensor(&binary_sensors[3]);
+    bms.set_precharging_binary_sensor(&binary_sensors[4]);
+    bms.set_battery_status_text_sensor(&text_sensors[0]);
+    bms.set_errors_text_sensor(&text_sensors[1]);
+    bms.set_software_version_text_sensor(&text_sensors[2]);
+    bms.set_hardware_version_text_sensor(&text_sensors[3]);
+    bms.set_balancer_switch(&switches[0]);
+    bms.set_charging_switch(&switches[1]);
+    bms.set_discharging_switch(&switches[2]);
+    // 0x0080-0x00A8: every register of the settings frame
+    for (uint16_t i = 0; i < 41; i++)
+      bms.register_settings_number(0x0080 + i, &numbers[i], 1.0f, 0.0f);
+  }
+
+  void notify(uint16_t address, uint16_t registers, const std::vector<uint8_t> &frame, size_t mtu_payload) {
+    bms.queue_sent_command_(0x03, address, registers);
+    for (size_t i = 0; i < frame.size(); i += mtu_payload)
+      bms.on_daly_bms_ble_notify(frame.data() + i, std::min(mtu_payload, frame.size() - i));
+  }
 };
 
 // ── D2 protocol: real frames from esp32-ble-example-faker.yaml ──────────────
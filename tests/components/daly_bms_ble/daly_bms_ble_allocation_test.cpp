@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <new>
+#include "common.h"
+
+// Counts heap allocations while enabled. Replaces the global allocation functions of the test binary.
+static bool g_count_allocations = false;
+static size_t g_allocations = 0;
+
+static void *counted_malloc(size_t size) {
+  if (g_count_allocations)
+    g_allocations++;
+  void *ptr = std::malloc(size != 0 ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new(size_t size) { return counted_malloc(size); }
+void *operator new[](size_t size) { return counted_malloc(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+namespace esphome::daly_bms_ble::testing {
+
+class AllocationScope {
+ public:
+  AllocationScope() {
+    g_allocations = 0;
+    g_count_allocations = true;
+  }
+  ~AllocationScope() { g_count_allocations = false; }
+  size_t count() const { return g_allocations; }
+};
+
+TEST(DalyBmsBleAllocationTest, D2NotifyPathDoesNotAllocate) {
+  ConfiguredBms configured;
+  auto d2_cycle = [&](size_t mtu_payload) {
+    configured.notify(0x0000, 80, STATUS_FRAME_80_REG_2, mtu_payload);
+    configured.notify(0x0000, 62, STATUS_FRAME_62_REG_NO_ALARMS, mtu_payload);
+    configured.notify(0x0080, 41, SETTINGS_FRAME_1, mtu_payload);
+    configured.notify(0x00CF, 1, BALANCER_SWITCH_FRAME_ON, mtu_payload);
+  };
+  d2_cycle(244);  // warm up
+
+  AllocationScope scope;
+  for (int i = 0; i < 10; i++) {
+    d2_cycle(244);
+    d2_cycle(20);
+  }
+  EXPECT_EQ(scope.count(), 0);
+  EXPECT_EQ(configured.bms.queue_size(), 0);
+}
+
+TEST(DalyBmsBleAllocationTest, P81NotifyPathDoesNotAllocate) {
+  ConfiguredBms configured;
+  configured.bms.set_protocol_version(0x81);
+  auto p81_cycle = [&](size_t mtu_payload) {
+    configured.notify(0x0000, 64, P81_CELLS_FRAME, mtu_payload);
+    configured.notify(0x0041, 62, P81_STATUS_FRAME, mtu_payload);
+    configured.notify(0x00CF, 1, P81_BALANCER_SWITCH_FRAME_ON, mtu_payload);
+  };
+  p81_cycle(244);  // warm up
+
+  AllocationScope scope;
+  for (int i = 0; i < 10; i++) {
+    p81_cycle(244);
+    p81_cycle(20);
+  }
+  EXPECT_EQ(scope.count(), 0);
+  EXPECT_EQ(configured.bms.queue_size(), 0);
+}
+
+}  // namespace esphome::daly_bms_ble::testing
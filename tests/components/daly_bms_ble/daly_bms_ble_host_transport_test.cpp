@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+#include "common.h"
+#include "simulated_bms.h"
+#include "esphome/components/daly_bms_ble/daly_transport.h"
+
+namespace esphome::daly_bms_ble::testing {
+
+// The other end of a host link, answering complete request frames from a register image
+struct LocalBms {
+  BmsRegisterImage image{0xD2};
+  int fd{-1};
+  std::vector<uint8_t> received;
+
+  LocalBms() {
+    image.load_frame(0x0000, STATUS_FRAME_80_REG_2);
+    image.load_frame(0x0080, SETTINGS_FRAME_1);
+    image.load_frame(0x00CF, BALANCER_SWITCH_FRAME_ON);
+  }
+  ~LocalBms() {
+    if (fd >= 0)
+      ::close(fd);
+  }
+
+  void serve() {
+    uint8_t buffer[64];
+    ssize_t length;
+    while ((length = ::read(fd, buffer, sizeof(buffer))) > 0)
+      received.insert(received.end(), buffer, buffer + length);
+    while (received.size() >= 8) {
+      std::vector<uint8_t> response;
+      if (image.respond(received.data(), 8, response)) {
+        ASSERT_EQ(::write(fd, response.data(), response.size()), (ssize_t) response.size());
+      }
+      received.erase(received.begin(), received.begin() + 8);
+    }
+  }
+};
+
+// Runs the component and the local BMS until the poll cycle completed or max_loops passed. A pty hands the
+// bytes over asynchronously, the local side waits up to 1 ms for them instead of spinning.
+static void run_until_polled(ConfiguredBms &configured, VirtualClock &clock, LocalBms &local, int max_loops = 1000) {
+  for (int i = 0; i < max_loops && configured.bms.get_command_successes() < 3; i++) {
+    clock.advance(1);
+    configured.bms.loop();
+    struct pollfd pfd = {local.fd, POLLIN, 0};
+    ::poll(&pfd, 1, 1);
+    local.serve();
+  }
+}
+
+// Starts a TCP connection of the transport and completes it with the listener
+static int accept_connection(ConfiguredBms &configured, DalyBmsHostTransport &transport, int listener) {
+  configured.bms.loop();
+  const int fd = ::accept(listener, nullptr, nullptr);
+  configured.bms.loop();
+  if (fd >= 0)
+    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+  return fd;
+}
+
+TEST(DalyBmsBleHostTransportTest, PollsOverPty) {
+  LocalBms local;
+  local.fd = ::posix_openpt(O_RDWR | O_NOCTTY);
+  ASSERT_GE(local.fd, 0);
+  ASSERT_EQ(::grantpt(local.fd), 0);
+  ASSERT_EQ(::unlockpt(local.fd), 0);
+  ::fcntl(local.fd, F_SETFL, O_NONBLOCK);
+
+  ConfiguredBms configured;
+  VirtualClock clock;
+  DalyBmsHostTransport transport(::ptsname(local.fd));
+  configured.bms.set_clock(&clock);
+  configured.bms.set_status_registers(80);
+  configured.bms.set_transport(&transport);
+
+  // The pty is open right away and the first poll cycle starts with the connection
+  configured.bms.loop();
+  ASSERT_TRUE(transport.is_connected());
+  run_until_polled(configured, clock, local);
+
+  EXPECT_EQ(configured.bms.get_command_successes(), 3u);
+  EXPECT_EQ(configured.bms.get_command_retries(), 0u);
+  EXPECT_FLOAT_EQ(configured.sensors[0].state, 52.5f);
+  EXPECT_TRUE(configured.switches[0].state);
+}
+
+TEST(DalyBmsBleHostTransportTest, PollsOverTcpAndNoticesDisconnect) {
+  const int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t address_length = sizeof(address);
+  ASSERT_EQ(::bind(listener, (sockaddr *) &address, sizeof(address)), 0);
+  ASSERT_EQ(::listen(listener, 1), 0);
+  ASSERT_EQ(::getsockname(listener, (sockaddr *) &address, &address_length), 0);
+
+  ConfiguredBms configured;
+  VirtualClock clock;
+  DalyBmsHostTransport transport("127.0.0.1:" + std::to_string(ntohs(address.sin_port)));
+  configured.bms.set_clock(&clock);
+  configured.bms.set_status_registers(80);
+  configured.bms.set_transport(&transport);
+
+  LocalBms local;
+  local.fd = accept_connection(configured, transport, listener);
+  ASSERT_GE(local.fd, 0);
+  ASSERT_TRUE(transport.is_connected());
+
+  run_until_polled(configured, clock, local);
+  EXPECT_EQ(configured.bms.get_command_successes(), 3u);
+  EXPECT_FLOAT_EQ(configured.sensors[0].state, 52.5f);
+
+  // A closed connection drops everything in flight, nothing is queued until the link is back
+  configured.bms.send_command(0x03, 0x0000, 0x0050);
+  ::close(local.fd);
+  local.fd = -1;
+  configured.bms.loop();
+  EXPECT_FALSE(transport.is_connected());
+  EXPECT_EQ(configured.bms.queue_size(), 0);
+  configured.bms.update();
+  EXPECT_EQ(configured.bms.queue_size(), 0);
+  ::close(listener);
+}
+
+TEST(DalyBmsBleHostTransportTest, ReconnectsAfterIntervalOfEngineClock) {
+  const int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t address_length = sizeof(address);
+  ASSERT_EQ(::bind(listener, (sockaddr *) &address, sizeof(address)), 0);
+  ASSERT_EQ(::listen(listener, 1), 0);
+  ASSERT_EQ(::getsockname(listener, (sockaddr *) &address, &address_length), 0);
+
+  ConfiguredBms configured;
+  VirtualClock clock;
+  DalyBmsHostTransport transport("127.0.0.1:" + std::to_string(ntohs(address.sin_port)));
+  configured.bms.set_clock(&clock);
+  configured.bms.set_transport(&transport);
+
+  int fd = accept_connection(configured, transport, listener);
+  ASSERT_GE(fd, 0);
+  ASSERT_TRUE(transport.is_connected());
+  ::close(fd);
+  configured.bms.loop();
+  ASSERT_FALSE(transport.is_connected());
+
+  // No new attempt within 5 s of the last one
+  clock.advance(4999);
+  configured.bms.loop();
+  struct pollfd pfd = {listener, POLLIN, 0};
+  EXPECT_EQ(::poll(&pfd, 1, 0), 0);
+  EXPECT_FALSE(transport.is_connected());
+
+  clock.advance(1);
+  fd = accept_connection(configured, transport, listener);
+  ASSERT_GE(fd, 0);
+  EXPECT_TRUE(transport.is_connected());
+  ::close(fd);
+  ::close(listener);
+}
+
+}  // namespace esphome::daly_bms_ble::testing
@@ -142,7 +142,7 @@ TEST(DalyBmsBleEssDlBmsCellsTest, DispatchedViaOnData) {
   sensor::Sensor voltage;
   bms.set_total_voltage_sensor(&voltage);
 
-  bms.queue_command_(0x03, 0x0000, 64);  // reg 0-63
+  bms.queue_sent_command_(0x03, 0x0000, 64);  // reg 0-63
   bms.on_daly_bms_ble_data(P81_CELLS_FRAME);
 
   EXPECT_NEAR(voltage.state, 53.0f, 0.01f);
@@ -303,12 +303,145 @@ TEST(DalyBmsBleEssDlBmsStatusTest, DispatchedViaOnData) {
   sensor::Sensor capacity;
   bms.set_capacity_remaining_sensor(&capacity);
 
-  bms.queue_command_(0x03, 0x0041, 62);  // reg 65-126
+  bms.queue_sent_command_(0x03, 0x0041, 62);  // reg 65-126
   bms.on_daly_bms_ble_data(P81_STATUS_FRAME);
 
   EXPECT_NEAR(capacity.state, 271.2f, 0.01f);
 }
 
+// ── Heartbeat counter (reg 0x003B) ───────────────────────────────────────────
+
+// The total voltage moves by 0.1 V per step, so every decoded frame publishes a new value
+static std::vector<uint8_t> cells_frame_with_heartbeat(uint16_t heartbeat, uint8_t step = 0) {
+  auto frame = P81_CELLS_FRAME;
+  frame[3 + 0x3B * 2] = heartbeat >> 8;
+  frame[4 + 0x3B * 2] = heartbeat & 0xFF;
+  frame[4 + 0x38 * 2] += step;
+  return frame;
+}
+
+// The remaining capacity moves by 0.1 Ah per step
+static std::vector<uint8_t> status_frame_with_step(uint8_t step) {
+  auto frame = P81_STATUS_FRAME;
+  frame[4 + (0x4B - 0x41) * 2] += step;
+  return frame;
+}
+
+TEST(DalyBmsBleEssDlBmsHeartbeatTest, UnchangedHeartbeatSkipsRealtimeData) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  sensor::Sensor voltage, capacity;
+  bms.set_total_voltage_sensor(&voltage);
+  bms.set_capacity_remaining_sensor(&capacity);
+
+  uint8_t step = 0;
+  for (uint16_t heartbeat : {1, 2, 2}) {
+    bms.decode_p81_cells_data_(cells_frame_with_heartbeat(heartbeat, step));
+    bms.decode_p81_status_data_(status_frame_with_step(step));
+    step++;
+  }
+
+  EXPECT_EQ(voltage.publish_count, 2);
+  EXPECT_EQ(capacity.publish_count, 2);
+
+  // The skip applies to the status frame of the same cycle only
+  bms.decode_p81_status_data_(status_frame_with_step(step));
+  EXPECT_EQ(capacity.publish_count, 3);
+}
+
+TEST(DalyBmsBleEssDlBmsHeartbeatTest, BmsWithoutHeartbeatIsAlwaysDecoded) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  sensor::Sensor voltage, sample_age;
+  bms.set_total_voltage_sensor(&voltage);
+  bms.set_bms_sample_age_sensor(&sample_age);
+
+  for (uint8_t i = 0; i < 3; i++)
+    bms.decode_p81_cells_data_(cells_frame_with_heartbeat(0, i));
+
+  EXPECT_EQ(voltage.publish_count, 3);
+  EXPECT_FALSE(sample_age.has_state());
+}
+
+TEST(DalyBmsBleEssDlBmsHeartbeatTest, SampleAge) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  sensor::Sensor sample_age;
+  bms.set_bms_sample_age_sensor(&sample_age);
+
+  bms.decode_p81_cells_data_(cells_frame_with_heartbeat(7));
+  delay(1000);
+  bms.decode_p81_cells_data_(cells_frame_with_heartbeat(8));
+  EXPECT_FLOAT_EQ(sample_age.state, 0.0f);
+
+  delay(3000);
+  bms.decode_p81_cells_data_(cells_frame_with_heartbeat(8));
+  EXPECT_FLOAT_EQ(sample_age.state, 3000.0f);
+}
+
+// ── Snapshot of a poll cycle ─────────────────────────────────────────────────
+
+TEST(DalyBmsBleEssDlBmsSnapshotTest, PublishedOnceBothRealtimeFramesArrived) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  sensor::Sensor voltage, capacity;
+  bms.set_total_voltage_sensor(&voltage);
+  bms.set_capacity_remaining_sensor(&capacity);
+  bms.queue_poll_blocks_(0);
+  bms.connect_sink_link_();
+
+  bms.on_daly_bms_ble_data(P81_CELLS_FRAME);
+  EXPECT_FALSE(voltage.has_state());
+  EXPECT_FALSE(bms.get_snapshot().has(BmsSnapshot::TOTAL_VOLTAGE));
+
+  bms.on_daly_bms_ble_data(P81_STATUS_FRAME);
+  EXPECT_NEAR(voltage.state, 53.0f, 0.01f);
+  EXPECT_NEAR(capacity.state, 271.2f, 0.01f);
+  EXPECT_TRUE(bms.get_snapshot().has(BmsSnapshot::TOTAL_VOLTAGE | BmsSnapshot::CAPACITY_REMAINING));
+}
+
+TEST(DalyBmsBleEssDlBmsSnapshotTest, FrontBufferKeepsLastCycle) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  bms.queue_poll_blocks_(0);
+  bms.connect_sink_link_();
+  bms.on_daly_bms_ble_data(P81_CELLS_FRAME);
+  bms.on_daly_bms_ble_data(P81_STATUS_FRAME);
+  bms.reset_queue();
+
+  auto frame = P81_CELLS_FRAME;
+  frame[3 + 0x38 * 2 + 1] += 1;  // 53.1 V
+  auto crc = crc16(frame.data(), frame.size() - 2);
+  frame[frame.size() - 2] = crc & 0xFF;
+  frame[frame.size() - 1] = crc >> 8;
+
+  bms.queue_poll_blocks_(10000);
+  bms.connect_sink_link_();
+  bms.on_daly_bms_ble_data(frame);
+  EXPECT_EQ(bms.get_snapshot().total_voltage, 530);
+
+  bms.on_daly_bms_ble_data(P81_STATUS_FRAME);
+  EXPECT_EQ(bms.get_snapshot().total_voltage, 531);
+}
+
+TEST(DalyBmsBleEssDlBmsSnapshotTest, IncompleteCycleIsPublishedWithNextCycle) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  sensor::Sensor voltage, capacity;
+  bms.set_total_voltage_sensor(&voltage);
+  bms.set_capacity_remaining_sensor(&capacity);
+  bms.queue_poll_blocks_(0);
+  bms.connect_sink_link_();
+
+  bms.on_daly_bms_ble_data(P81_CELLS_FRAME);
+  bms.reset_queue();
+  bms.queue_poll_blocks_(10000);
+
+  EXPECT_NEAR(voltage.state, 53.0f, 0.01f);
+  EXPECT_FALSE(capacity.has_state());
+  EXPECT_FALSE(bms.get_snapshot().has(BmsSnapshot::CAPACITY_REMAINING));
+}
+
 // ── Balancer switch frame (reg 0x00CF) ───────────────────────────────────────
 
 TEST(DalyBmsBleEssDlBmsBalancerSwitchTest, SwitchOn) {
@@ -332,7 +465,7 @@ TEST(DalyBmsBleEssDlBmsBalancerSwitchTest, DispatchedViaOnData) {
   TestSwitch balancer;
   bms.set_balancer_switch(&balancer);
 
-  bms.queue_command_(0x03, 0x00CF, 1);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
   bms.on_daly_bms_ble_data(P81_BALANCER_SWITCH_FRAME_ON);
 
   EXPECT_TRUE(balancer.state);
@@ -381,7 +514,7 @@ TEST(DalyBmsBleEssDlBmsVersionTest, DispatchedViaOnData) {
   text_sensor::TextSensor sw_version;
   bms.set_software_version_text_sensor(&sw_version);
 
-  bms.queue_command_(0x03, 0x0178, 74);  // reg 0x0178-0x01C1
+  bms.queue_sent_command_(0x03, 0x0178, 74);  // reg 0x0178-0x01C1
   bms.on_daly_bms_ble_data(P81_VERSION_FRAME);
 
   EXPECT_EQ(sw_version.state, "41_260321_0323ESS-DL-BMS");
@@ -430,4 +563,64 @@ TEST(DalyBmsBleEssDlBmsRequestFrameTest, DlBalancerSwitch) {
             (std::array<uint8_t, 8>{0x81, 0x03, 0x00, 0xCF, 0x00, 0x01, 0xAB, 0xF5}));
 }
 
+// ── Poll scheduler ───────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleEssDlBmsSchedulerTest, FirstCycleQueuesAllBlocks) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  bms.queue_poll_blocks_(0);
+  bms.connect_sink_link_();
+
+  EXPECT_EQ(bms.queue_size(), 10);
+}
+
+TEST(DalyBmsBleEssDlBmsSchedulerTest, RealtimeBlocksPolledEveryCycle) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  bms.queue_poll_blocks_(0);
+  bms.connect_sink_link_();
+  bms.reset_queue();
+
+  bms.queue_poll_blocks_(10000);
+
+  auto &queue = bms.get_queue();
+  ASSERT_EQ(bms.queue_size(), 2);
+  EXPECT_EQ(queue.at(0).address, 0x0000);
+  EXPECT_EQ(queue.at(1).address, 0x0041);
+}
+
+TEST(DalyBmsBleEssDlBmsSchedulerTest, AlarmsPolledAtAlarmsInterval) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  bms.set_alarms_update_interval(30000);
+  bms.queue_poll_blocks_(0);
+  bms.connect_sink_link_();
+  bms.reset_queue();
+
+  bms.queue_poll_blocks_(30000);
+
+  auto &queue = bms.get_queue();
+  ASSERT_EQ(bms.queue_size(), 3);
+  EXPECT_EQ(queue.at(2).address, 0x00A4);
+}
+
+TEST(DalyBmsBleEssDlBmsSchedulerTest, VersionPolledOncePerConnection) {
+  TestableDalyBmsBle bms;
+  bms.set_protocol_version(0x81);
+  bms.queue_poll_blocks_(0);
+  bms.connect_sink_link_();
+  bms.reset_queue();
+
+  // All other tiers are due again, the version block is not
+  bms.queue_poll_blocks_(3600000);
+  EXPECT_EQ(bms.queue_size(), 9);
+  for (uint8_t i = 0; i < bms.queue_size(); i++)
+    EXPECT_NE(bms.get_queue().at(i).address, 0x0178);
+  bms.reset_queue();
+
+  bms.invalidate_poll_blocks_();
+  bms.queue_poll_blocks_(3610000);
+  EXPECT_EQ(bms.queue_size(), 10);
+}
+
 }  // namespace esphome::daly_bms_ble::testing
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "common.h"
+#include "pdus.h"
+#include "replay.h"
+
+namespace esphome::daly_bms_ble::testing {
+
+// Builds a btsnoop HCI log (H4 datalink) with ATT packets on the fixed attribute channel
+class BtsnoopWriter {
+ public:
+  BtsnoopWriter() {
+    const uint8_t header[16] = {'b', 't', 's', 'n', 'o', 'o', 'p', 0, 0, 0, 0, 1, 0, 0, 0x03, 0xEA};
+    this->log_.assign(header, header + 16);
+  }
+
+  void write(uint64_t timestamp_us, const std::vector<uint8_t> &value) { this->add_(timestamp_us, 0, 0x52, value); }
+  void notify(uint64_t timestamp_us, const std::vector<uint8_t> &value) { this->add_(timestamp_us, 1, 0x1B, value); }
+
+  const std::vector<uint8_t> &log() const { return this->log_; }
+
+ protected:
+  void add_(uint64_t timestamp_us, uint32_t flags, uint8_t opcode, const std::vector<uint8_t> &value) {
+    const uint16_t att_length = value.size() + 3;
+    std::vector<uint8_t> packet = {0x02, 0x01, 0x00, uint8_t(att_length + 4), 0x00, uint8_t(att_length), 0x00,
+                                   0x04, 0x00, opcode, 0x10, 0x00};
+    packet.insert(packet.end(), value.begin(), value.end());
+    this->put_32bit_(packet.size());
+    this->put_32bit_(packet.size());
+    this->put_32bit_(flags);
+    this->put_32bit_(0);
+    this->put_32bit_(timestamp_us >> 32);
+    this->put_32bit_(timestamp_us & 0xFFFFFFFF);
+    this->log_.insert(this->log_.end(), packet.begin(), packet.end());
+  }
+  void put_32bit_(uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+      this->log_.push_back(value >> shift);
+  }
+
+  std::vector<uint8_t> log_;
+};
+
+static const uint64_t CAPTURE_START_US = 1000000000;
+
+static std::vector<uint8_t> read_request(uint16_t address, uint16_t count) {
+  std::vector<uint8_t> request = {0xD2, 0x03, uint8_t(address >> 8), uint8_t(address), uint8_t(count >> 8),
+                                  uint8_t(count)};
+  const uint16_t crc = crc16(request.data(), request.size());
+  request.push_back(crc & 0xFF);
+  request.push_back(crc >> 8);
+  return request;
+}
+
+// ── Capture parsing ──────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleReplayTest, ParseHexLineAcceptsBothDumpFormats) {
+  EXPECT_EQ(parse_hex_line("0xD2, 0x03, 0x02, 0x00, 0x01, 0xFC, 0x56,"), BALANCER_SWITCH_FRAME_ON);
+  EXPECT_EQ(parse_hex_line("d2.03.02.00.01.fc.56 (7)"), std::vector<uint8_t>({0xD2, 0x03, 0x02, 0x00, 0x01, 0xFC,
+                                                                               0x56, 0x07}));
+}
+
+TEST(DalyBmsBleReplayTest, BtsnoopReassemblesFragmentedResponse) {
+  BtsnoopWriter writer;
+  writer.write(CAPTURE_START_US, read_request(0x0000, 80));
+  const auto &frame = STATUS_FRAME_80_REG_2;
+  for (size_t i = 0; i < frame.size(); i += 20) {
+    const size_t end = std::min(frame.size(), i + 20);
+    writer.notify(CAPTURE_START_US + 250000, std::vector<uint8_t>(frame.begin() + i, frame.begin() + end));
+  }
+
+  auto pdus = parse_btsnoop(writer.log());
+  ASSERT_EQ(pdus.size(), 1u);
+  EXPECT_EQ(pdus[0].address, 0x0000);
+  EXPECT_EQ(pdus[0].value, 80);
+  EXPECT_EQ(pdus[0].response, frame);
+  EXPECT_EQ(pdus[0].millis, 250u);
+}
+
+TEST(DalyBmsBleReplayTest, BtsnoopSplitsConcatenatedResponses) {
+  BtsnoopWriter writer;
+  writer.write(CAPTURE_START_US, read_request(0x00CF, 1));
+  writer.write(CAPTURE_START_US + 1000, read_request(0x00A9, 32));
+  std::vector<uint8_t> notification = BALANCER_SWITCH_FRAME_OFF;
+  notification.insert(notification.end(), VERSION_FRAME_1.begin(), VERSION_FRAME_1.end());
+  writer.notify(CAPTURE_START_US + 2000, notification);
+
+  auto pdus = parse_btsnoop(writer.log());
+  ASSERT_EQ(pdus.size(), 2u);
+  EXPECT_EQ(pdus[0].address, 0x00CF);
+  EXPECT_EQ(pdus[0].response, BALANCER_SWITCH_FRAME_OFF);
+  EXPECT_EQ(pdus[1].address, 0x00A9);
+  EXPECT_EQ(pdus[1].response, VERSION_FRAME_1);
+}
+
+TEST(DalyBmsBleReplayTest, BtsnoopSkipsNoiseAndUnansweredRequests) {
+  BtsnoopWriter writer;
+  writer.write(CAPTURE_START_US, read_request(0x0000, 80));
+  writer.notify(CAPTURE_START_US + 100000, {'+', 'O', 'K', '\r', '\n'});
+  // Same register count, only the second read is answered within the timeout
+  writer.write(CAPTURE_START_US + 10000000, read_request(0x0010, 80));
+  writer.notify(CAPTURE_START_US + 10100000, STATUS_FRAME_80_REG_1);
+
+  auto pdus = parse_btsnoop(writer.log());
+  ASSERT_EQ(pdus.size(), 1u);
+  EXPECT_EQ(pdus[0].address, 0x0010);
+  EXPECT_EQ(pdus[0].millis, 10100u);
+  EXPECT_TRUE(parse_btsnoop(std::vector<uint8_t>(writer.log().begin() + 1, writer.log().end())).empty());
+}
+
+// ── Replay ───────────────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleReplayTest, RecordsStateChangesAsTimeSeries) {
+  const std::vector<Pdu> pdus = {
+      {0x03, 0x0000, 80, STATUS_FRAME_80_REG_1, 0},
+      {0x03, 0x0080, 41, SETTINGS_FRAME_1, 1000},
+      {0x03, 0x0000, 80, STATUS_FRAME_80_REG_2, 2000},
+  };
+  Replay replay;
+  auto result = replay.run(pdus);
+
+  EXPECT_EQ(result.frames, 3u);
+  EXPECT_EQ(replay.pending_commands(), 0);
+  auto find = [&](uint32_t millis, const char *entity) -> const Replay::Sample * {
+    for (const auto &sample : result.samples) {
+      if (sample.millis == millis && strcmp(sample.entity, entity) == 0)
+        return &sample;
+    }
+    return nullptr;
+  };
+  ASSERT_NE(find(0, "total_voltage"), nullptr);
+  EXPECT_EQ(find(0, "total_voltage")->value, "52.500");
+  ASSERT_NE(find(0, "cell_voltage_1"), nullptr);
+  EXPECT_EQ(find(0, "cell_voltage_1")->value, "3.281");
+  ASSERT_NE(find(1000, "setting_0x0080"), nullptr);
+  ASSERT_NE(find(2000, "cell_voltage_1"), nullptr);
+  EXPECT_EQ(find(2000, "cell_voltage_1")->value, "3.279");
+  // Unchanged states are not repeated
+  EXPECT_EQ(find(2000, "total_voltage"), nullptr);
+
+  std::ostringstream csv;
+  Replay::write_csv(result, csv);
+  EXPECT_EQ(csv.str().rfind("millis,entity,value\n0,", 0), 0u);
+}
+
+// Replays every capture of docs/pdus. Set DALY_BMS_REPLAY_OUTPUT to a directory to keep the time series as CSV and
+// DALY_BMS_REPLAY_SPEED to pace the replay (1 = real time).
+TEST(DalyBmsBleReplayTest, ReplaysCapturedTraffic) {
+  const std::string dir = pdus_dir();
+  if (dir.empty())
+    GTEST_SKIP() << "DALY_BMS_PDUS_DIR is not set";
+  const char *output = std::getenv("DALY_BMS_REPLAY_OUTPUT");
+  const char *speed = std::getenv("DALY_BMS_REPLAY_SPEED");
+
+  for (const char *file : {"btsnoop_daly_balancer.log", "daly_bms_24cells.txt",
+                           "daly_bms_blue_series_80_registers.txt", "ess-dl-bms-41_260321_0323.txt"}) {
+    SCOPED_TRACE(file);
+    auto pdus = load_capture(dir + "/" + file);
+    ASSERT_FALSE(pdus.empty());
+
+    Replay replay(speed != nullptr ? strtof(speed, nullptr) : 0.0f);
+    auto result = replay.run(pdus);
+    EXPECT_EQ(result.frames, pdus.size());
+    EXPECT_EQ(replay.pending_commands(), 0);
+    EXPECT_FALSE(result.samples.empty());
+    printf("%-40s %5zu frames %7zu bytes %10.0f frames/s %6zu changes\n", file, result.frames, result.bytes,
+           result.frames_per_second(), result.samples.size());
+
+    if (output != nullptr) {
+      std::ofstream csv(std::string(output) + "/" + file + ".csv");
+      Replay::write_csv(result, csv);
+    }
+  }
+}
+
+}  // namespace esphome::daly_bms_ble::testing
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <cinttypes>
+#include <cstdio>
+#include "common.h"
+#include "simulated_bms.h"
+
+namespace esphome::daly_bms_ble::testing {
+
+// A D2 BMS with 16 cells, answering 80 register status reads
+struct SimulatedD2Bms {
+  ConfiguredBms configured;
+  SimulatedBms simulated{&configured.bms, 0xD2};
+
+  SimulatedD2Bms() {
+    configured.bms.set_status_registers(80);
+    simulated.load_frame(0x0000, STATUS_FRAME_80_REG_2);
+    simulated.load_frame(0x0080, SETTINGS_FRAME_1);
+    simulated.load_frame(0x00CF, BALANCER_SWITCH_FRAME_ON);
+  }
+};
+
+// A P81 BMS serving the ESS-DL-BMS capture
+struct SimulatedP81Bms {
+  ConfiguredBms configured;
+  SimulatedBms simulated{&configured.bms, 0x81};
+
+  SimulatedP81Bms() {
+    simulated.load_frame(0x0000, P81_CELLS_FRAME);
+    simulated.load_frame(0x0041, P81_STATUS_FRAME);
+    simulated.load_frame(0x00CF, P81_BALANCER_SWITCH_FRAME_ON);
+    simulated.load_frame(0x0178, P81_VERSION_FRAME);
+  }
+};
+
+static void print_cycles(const char *name, const std::vector<PollCycle> &cycles, const SimulatedBms::Stats &stats) {
+  uint32_t total = 0, longest = 0;
+  for (const auto &cycle : cycles) {
+    total += cycle.duration_ms;
+    longest = std::max(longest, cycle.duration_ms);
+  }
+  printf("%-28s %3zu cycles, avg %5" PRIu32 " ms, max %5" PRIu32 " ms, %3" PRIu32 " lost, %3" PRIu32
+         " corrupted, %3" PRIu32 " reordered\n",
+         name, cycles.size(), total / uint32_t(cycles.size()), longest, stats.lost, stats.corrupted, stats.reordered);
+}
+
+// ── Ideal link ───────────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleSimulationTest, D2PollCycleDecodesRegisterImage) {
+  SimulatedD2Bms sim;
+  auto cycle = run_poll_cycle(sim.configured.bms, sim.simulated);
+
+  ASSERT_TRUE(cycle.completed);
+  // Status, settings and balancer switch, one after the other
+  EXPECT_EQ(sim.simulated.stats().requests, 3u);
+  EXPECT_GE(cycle.duration_ms, 3 * 20u);
+  EXPECT_EQ(sim.configured.bms.get_command_successes(), 3u);
+  EXPECT_EQ(sim.configured.bms.get_command_retries(), 0u);
+  EXPECT_FLOAT_EQ(sim.configured.sensors[0].state, 52.5f);
+  EXPECT_FLOAT_EQ(sim.configured.cells[0].state, 3.279f);
+  EXPECT_TRUE(sim.configured.switches[0].state);
+  EXPECT_TRUE(sim.configured.binary_sensors[0].state);
+
+  // Only the realtime block is due in the next cycle
+  cycle = run_poll_cycle(sim.configured.bms, sim.simulated);
+  ASSERT_TRUE(cycle.completed);
+  EXPECT_EQ(sim.simulated.stats().requests, 4u);
+}
+
+TEST(DalyBmsBleSimulationTest, P81PipelineShortensPollCycle) {
+  SimulatedP81Bms sequential;
+  const auto sequential_cycle = run_poll_cycle(sequential.configured.bms, sequential.simulated);
+
+  SimulatedP81Bms pipelined;
+  pipelined.configured.bms.set_pipeline_depth(4);
+  const auto pipelined_cycle = run_poll_cycle(pipelined.configured.bms, pipelined.simulated);
+
+  ASSERT_TRUE(sequential_cycle.completed);
+  ASSERT_TRUE(pipelined_cycle.completed);
+  EXPECT_EQ(pipelined.simulated.stats().requests, sequential.simulated.stats().requests);
+  EXPECT_LT(pipelined_cycle.duration_ms * 2, sequential_cycle.duration_ms);
+  EXPECT_EQ(pipelined.configured.bms.get_snapshot().total_voltage, 530);
+  EXPECT_EQ(pipelined.configured.text_sensors[2].state, "41_260321_0323ESS-DL-BMS");
+}
+
+TEST(DalyBmsBleSimulationTest, WriteUpdatesRegisterImage) {
+  SimulatedD2Bms sim;
+  ASSERT_TRUE(run_poll_cycle(sim.configured.bms, sim.simulated).completed);
+
+  sim.configured.bms.send_command(0x06, 0x00CF, 0x0000);
+  auto cycle = run_poll_cycle(sim.configured.bms, sim.simulated);
+  ASSERT_TRUE(cycle.completed);
+  EXPECT_EQ(sim.simulated.get_register(0x00CF), 0x0000);
+  EXPECT_EQ(sim.configured.bms.get_command_failures(), 0u);
+}
+
+TEST(DalyBmsBleSimulationTest, DisconnectedLinkQueuesNothing) {
+  SimulatedD2Bms sim;
+  sim.simulated.set_connected(false);
+  sim.configured.bms.update();
+  EXPECT_EQ(sim.configured.bms.queue_size(), 0);
+  EXPECT_EQ(sim.simulated.stats().requests, 0u);
+}
+
+// ── Bad radio conditions ─────────────────────────────────────────────────────
+
+TEST(DalyBmsBleSimulationTest, FragmentedAndReorderedResponsesAreMatched) {
+  SimulatedD2Bms sim;
+  sim.configured.bms.set_pipeline_depth(3);
+  sim.simulated.set_link({.latency_ms = 15, .jitter_ms = 10, .notification_size = 7, .reordering = 0.5f});
+
+  std::vector<PollCycle> cycles;
+  for (int i = 0; i < 10; i++) {
+    sim.configured.bms.invalidate_poll_blocks_();
+    cycles.push_back(run_poll_cycle(sim.configured.bms, sim.simulated));
+    ASSERT_TRUE(cycles.back().completed);
+  }
+  print_cycles("fragmented, reordered", cycles, sim.simulated.stats());
+
+  EXPECT_GT(sim.simulated.stats().reordered, 0u);
+  EXPECT_EQ(sim.configured.bms.get_command_successes(), 30u);
+  EXPECT_EQ(sim.configured.bms.get_command_failures(), 0u);
+  EXPECT_FLOAT_EQ(sim.configured.sensors[0].state, 52.5f);
+}
+
+TEST(DalyBmsBleSimulationTest, LostAndCorruptedResponsesAreRetried) {
+  SimulatedD2Bms sim;
+  sim.configured.bms.set_read_retries(6);
+  sim.simulated.set_link({.latency_ms = 20, .loss = 0.2f, .corruption = 0.2f});
+
+  std::vector<PollCycle> cycles;
+  uint8_t max_queue_size = 0;
+  for (int i = 0; i < 10; i++) {
+    sim.configured.bms.invalidate_poll_blocks_();
+    cycles.push_back(run_poll_cycle(sim.configured.bms, sim.simulated));
+    ASSERT_TRUE(cycles.back().completed);
+    max_queue_size = std::max(max_queue_size, cycles.back().max_queue_size);
+  }
+  print_cycles("lossy, corrupted", cycles, sim.simulated.stats());
+
+  const auto &stats = sim.simulated.stats();
+  EXPECT_GT(stats.lost + stats.corrupted, 0u);
+  // A corrupted length byte may swallow the next response as well
+  EXPECT_GE(sim.configured.bms.get_command_retries(), stats.lost + stats.corrupted);
+  EXPECT_EQ(sim.configured.bms.get_command_failures(), 0u);
+  EXPECT_EQ(max_queue_size, 3);
+  EXPECT_EQ(sim.configured.bms.get_poll_cycle_overruns(), 0u);
+  EXPECT_FLOAT_EQ(sim.configured.cells[0].state, 3.279f);
+}
+
+}  // namespace esphome::daly_bms_ble::testing
@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
 #include "common.h"
 
 namespace esphome::daly_bms_ble::testing {
@@ -65,7 +67,7 @@ TEST(DalyBmsBleVersionTest, DispatchedViaOnData) {
   text_sensor::TextSensor sw_version;
   bms.set_software_version_text_sensor(&sw_version);
 
-  bms.queue_command_(0x03, 0x00A9, 0x20);
+  bms.queue_sent_command_(0x03, 0x00A9, 0x20);
   bms.on_daly_bms_ble_data(VERSION_FRAME_1);
 
   EXPECT_EQ(sw_version.state, "401012");
@@ -76,7 +78,7 @@ TEST(DalyBmsBleVersionTest, SecondFrameDispatchedViaOnData) {
   text_sensor::TextSensor sw_version;
   bms.set_software_version_text_sensor(&sw_version);
 
-  bms.queue_command_(0x03, 0x00A9, 0x20);
+  bms.queue_sent_command_(0x03, 0x00A9, 0x20);
   bms.on_daly_bms_ble_data(VERSION_FRAME_2);
 
   EXPECT_EQ(sw_version.state, "204012");
@@ -96,7 +98,7 @@ TEST(DalyBmsBlePasswordTest, WrongFrameSizeIsRejected) {
 
 TEST(DalyBmsBlePasswordTest, DispatchedViaOnData) {
   TestableDalyBmsBle bms;
-  bms.queue_command_(0x03, 0x00C9, 0x03);
+  bms.queue_sent_command_(0x03, 0x00C9, 0x03);
   bms.on_daly_bms_ble_data(PASSWORD_FRAME_1);
 }
 
@@ -452,7 +454,7 @@ TEST(DalyBmsBleSettingsTest, DispatchedViaOnData) {
   TestSwitch charging;
   bms.set_charging_switch(&charging);
 
-  bms.queue_command_(0x03, 0x0080, 41);
+  bms.queue_sent_command_(0x03, 0x0080, 41);
   bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
 
   EXPECT_TRUE(charging.state);
@@ -540,6 +542,24 @@ TEST(DalyBmsBleStatus80RegTest, TemperatureSensors) {
   EXPECT_FLOAT_EQ(temp_sensors.state, 4.0f);
 }
 
+TEST(DalyBmsBleStatus80RegTest, TemperatureSensorsAboveEightArePublishedUnclamped) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor temp_sensors, t1, t8;
+  bms.set_temperature_sensors_sensor(&temp_sensors);
+  bms.set_temperature_sensor(0, &t1);
+  bms.set_temperature_sensor(7, &t8);
+
+  // Register 0x0032 reports 12 probes, only the 8 temperature registers are decoded
+  std::vector<uint8_t> frame = STATUS_FRAME_80_REG_2;
+  frame[3 + 0x32 * 2] = 0x00;
+  frame[3 + 0x32 * 2 + 1] = 12;
+  bms.decode_status_data_(frame);
+
+  EXPECT_FLOAT_EQ(temp_sensors.state, 12.0f);
+  EXPECT_TRUE(t1.has_state());
+  EXPECT_TRUE(t8.has_state());
+}
+
 TEST(DalyBmsBleStatus80RegTest, ChargingCycles) {
   TestableDalyBmsBle bms;
   sensor::Sensor cycles;
@@ -684,7 +704,7 @@ TEST(DalyBmsBleStatus80RegTest, DispatchedViaOnData) {
   sensor::Sensor voltage;
   bms.set_total_voltage_sensor(&voltage);
 
-  bms.queue_command_(0x03, 0x0000, 80);
+  bms.queue_sent_command_(0x03, 0x0000, 80);
   bms.on_daly_bms_ble_data(STATUS_FRAME_80_REG_2);
 
   EXPECT_NEAR(voltage.state, 52.5f, 0.01f);
@@ -775,6 +795,18 @@ TEST(DalyBmsBleStatus62RegTest, EightCellVoltages) {
   EXPECT_NEAR(max_v.state, 3.543f, 0.001f);
 }
 
+TEST(DalyBmsBleStatus62RegTest, RegistersBeyondFrameAreSkipped) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor mosfet_temp, board_temp;
+  bms.set_mosfet_temperature_sensor(&mosfet_temp);
+  bms.set_board_temperature_sensor(&board_temp);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+
+  EXPECT_FALSE(mosfet_temp.has_state());
+  EXPECT_FALSE(board_temp.has_state());
+}
+
 TEST(DalyBmsBleStatus62RegTest, OneTemperature) {
   TestableDalyBmsBle bms;
   sensor::Sensor t1;
@@ -808,7 +840,7 @@ TEST(DalyBmsBleStatus62RegTest, DispatchedViaOnData) {
   sensor::Sensor voltage;
   bms.set_total_voltage_sensor(&voltage);
 
-  bms.queue_command_(0x03, 0x0000, 62);
+  bms.queue_sent_command_(0x03, 0x0000, 62);
   bms.on_daly_bms_ble_data(STATUS_FRAME_62_REG_NO_ALARMS);
 
   EXPECT_NEAR(voltage.state, 27.1f, 0.01f);
@@ -906,6 +938,63 @@ TEST(DalyBmsBleAlarmTest, TemperatureDifferenceWarningOnly) {
   EXPECT_EQ(errors.state, "Warning: Temperature difference too high");
 }
 
+TEST(DalyBmsBleAlarmTest, UnchangedAlarmsAreNotRebuiltWithoutHeartbeat) {
+  TestableDalyBmsBle bms;
+  text_sensor::TextSensor errors;
+  text_sensor::TextSensor status;
+  bms.set_errors_text_sensor(&errors);
+  bms.set_battery_status_text_sensor(&status);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_ALARM_TEMP_DIFF_BOTH);
+  // A rebuilt text would differ from these states and be published again
+  errors.raw_state = "";
+  status.raw_state = "";
+  bms.decode_status_data_(STATUS_FRAME_62_REG_ALARM_TEMP_DIFF_BOTH);
+  EXPECT_EQ(errors.publish_count, 1);
+  EXPECT_EQ(status.publish_count, 1);
+}
+
+TEST(DalyBmsBleAlarmTest, UnchangedAlarmsAreNotRepublished) {
+  TestableDalyBmsBle bms;
+  text_sensor::TextSensor errors;
+  text_sensor::TextSensor status;
+  bms.set_errors_text_sensor(&errors);
+  bms.set_battery_status_text_sensor(&status);
+  bms.set_heartbeat_interval(300000);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_ALARM_TEMP_DIFF_BOTH);
+  bms.decode_status_data_(STATUS_FRAME_62_REG_ALARM_TEMP_DIFF_BOTH);
+  EXPECT_EQ(errors.publish_count, 1);
+  EXPECT_EQ(status.publish_count, 1);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_ALARM_TEMP_DIFF_WARNING);
+  EXPECT_EQ(errors.publish_count, 2);
+  EXPECT_EQ(errors.state, "Warning: Temperature difference too high");
+}
+
+TEST(DalyBmsBleAlarmTest, AlarmsAreRepublishedAfterOffline) {
+  TestableDalyBmsBle bms;
+  text_sensor::TextSensor errors;
+  bms.set_errors_text_sensor(&errors);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_ALARM_AFE_FAILURE);
+  bms.publish_device_unavailable_();
+  EXPECT_EQ(errors.state, "Offline");
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_ALARM_AFE_FAILURE);
+  EXPECT_EQ(errors.state, "AFE acquisition chip failure");
+}
+
+TEST(DalyBmsBleAlarmTest, ErrorsTextIsTruncatedAtMessageBoundary) {
+  static const char *const MESSAGES[] = {"0123456789", "abcdefghij", "ABCDEFGHIJ"};
+  char buffer[24];
+
+  size_t length = TestableDalyBmsBle::bitmask_to_text_(MESSAGES, 3, 0b111, buffer, sizeof(buffer));
+
+  EXPECT_EQ(length, 21u);
+  EXPECT_STREQ(buffer, "0123456789;abcdefghij");
+}
+
 // ── Balancer switch frame (data_len=0x02) ────────────────────────────────────
 
 TEST(DalyBmsBleBalancerSwitchTest, SwitchOn) {
@@ -938,7 +1027,7 @@ TEST(DalyBmsBleBalancerSwitchTest, DispatchedViaOnDataOn) {
   TestSwitch balancer;
   bms.set_balancer_switch(&balancer);
 
-  bms.queue_command_(0x03, 0x00CF, 1);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
   bms.on_daly_bms_ble_data(BALANCER_SWITCH_FRAME_ON);
 
   EXPECT_TRUE(balancer.state);
@@ -949,7 +1038,7 @@ TEST(DalyBmsBleBalancerSwitchTest, DispatchedViaOnDataOff) {
   TestSwitch balancer;
   bms.set_balancer_switch(&balancer);
 
-  bms.queue_command_(0x03, 0x00CF, 1);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
   bms.on_daly_bms_ble_data(BALANCER_SWITCH_FRAME_OFF);
 
   EXPECT_FALSE(balancer.state);
@@ -1043,26 +1132,28 @@ TEST(DalyBmsBleQueueTest, QueueFullDropsCommand) {
   EXPECT_EQ(bms.queue_size(), max_size);
 }
 
-TEST(DalyBmsBleQueueTest, AdvanceDecrementsSize) {
-  TestableDalyBmsBle bms;
-  bms.queue_command_(0x03, 0x0000, 62);
-  bms.queue_command_(0x03, 0x0080, 41);
+TEST(DalyBmsBleQueueTest, RemoveDecrementsSize) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.enqueue(0x03, 0x0000, 62);
+  queue.enqueue(0x03, 0x0080, 41);
+  queue.mark_pending(0, 3000);
 
-  bms.advance_command_queue_();
+  queue.remove(0);
 
-  EXPECT_EQ(bms.queue_size(), 1);
-  EXPECT_FALSE(bms.command_pending());
+  EXPECT_EQ(queue.size(), 1);
+  EXPECT_FALSE(queue.pending());
+  EXPECT_EQ(queue.front().address, 0x0080);
 }
 
-TEST(DalyBmsBleQueueTest, AdvanceDrainsFully) {
-  TestableDalyBmsBle bms;
-  bms.queue_command_(0x03, 0x0000, 62);
-  bms.queue_command_(0x03, 0x0080, 41);
+TEST(DalyBmsBleQueueTest, RemoveDrainsFully) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.enqueue(0x03, 0x0000, 62);
+  queue.enqueue(0x03, 0x0080, 41);
 
-  bms.advance_command_queue_();
-  bms.advance_command_queue_();
+  queue.remove(0);
+  queue.remove(0);
 
-  EXPECT_EQ(bms.queue_size(), 0);
+  EXPECT_EQ(queue.size(), 0);
 }
 
 TEST(DalyBmsBleQueueTest, ResetClearsQueue) {
@@ -1077,36 +1168,65 @@ TEST(DalyBmsBleQueueTest, ResetClearsQueue) {
 }
 
 TEST(DalyBmsBleQueueTest, WrapAround) {
-  TestableDalyBmsBle bms;
+  TestableDalyBmsBle::CommandQueue queue;
   for (uint8_t i = 0; i < 9; i++)
-    bms.queue_command_(0x03, i, 0);
+    queue.enqueue(0x03, i, 0);
   for (int i = 0; i < 5; i++)
-    bms.advance_command_queue_();
+    queue.remove(0);
 
-  EXPECT_EQ(bms.queue_size(), 4);
+  EXPECT_EQ(queue.size(), 4);
 
-  for (uint8_t i = 0; i < 5; i++)
-    bms.queue_command_(0x03, 0x10 + i, 0);
+  for (uint8_t i = 0; i < 12; i++)
+    queue.enqueue(0x03, 0x10 + i, 0);
 
-  EXPECT_EQ(bms.queue_size(), 9);
+  ASSERT_EQ(queue.size(), TestableDalyBmsBle::CommandQueue::LENGTH - 1);
+  EXPECT_EQ(queue.at(0).address, 5);
+  EXPECT_EQ(queue.at(14).address, 0x10 + 10);
 }
 
-TEST(DalyBmsBleQueueTest, AdvanceOnEmptyQueueIsNoop) {
-  TestableDalyBmsBle bms;
-  bms.advance_command_queue_();
-  EXPECT_EQ(bms.queue_size(), 0);
-  EXPECT_FALSE(bms.command_pending());
+TEST(DalyBmsBleQueueTest, RemoveOnEmptyQueueIsNoop) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.remove(0);
+  EXPECT_EQ(queue.size(), 0);
+  EXPECT_FALSE(queue.pending());
 }
 
 TEST(DalyBmsBleQueueTest, ValidResponseAdvancesQueue) {
   TestableDalyBmsBle bms;
   bms.queue_command_(0x03, 0x0000, 62);
   bms.queue_command_(0x03, 0x0080, 41);
+  bms.connect_sink_link_();
 
   bms.on_daly_bms_ble_data(STATUS_FRAME_80_REG_2);
 
+  // The settings read is sent once the status response arrived
   EXPECT_EQ(bms.queue_size(), 1);
-  EXPECT_FALSE(bms.command_pending());
+  EXPECT_TRUE(bms.command_pending());
+  EXPECT_EQ(bms.get_queue().at(0).address, 0x0080);
+}
+
+TEST(DalyBmsBleQueueTest, ResponseWithoutCommandInFlightKeepsQueue) {
+  TestableDalyBmsBle bms;
+  bms.queue_command_(0x03, 0x0000, 62);
+
+  bms.on_daly_bms_ble_data(STATUS_FRAME_80_REG_2);
+
+  EXPECT_EQ(bms.queue_size(), 1);
+  EXPECT_EQ(bms.get_command_successes(), 0u);
+}
+
+TEST(DalyBmsBleQueueTest, LateResponseDoesNotCompleteWriteInFlight) {
+  TestableDalyBmsBle bms;
+  bms.queue_command_(0x06, 0x00A5, 0x0000);
+  bms.connect_sink_link_();
+
+  // The response to a read which timed out already arrives while the write waits for its echo
+  bms.on_daly_bms_ble_data(STATUS_FRAME_80_REG_2);
+
+  ASSERT_EQ(bms.queue_size(), 1);
+  EXPECT_TRUE(bms.command_pending());
+  EXPECT_EQ(bms.get_queue().at(0).address, 0x00A5);
+  EXPECT_EQ(bms.get_command_successes(), 0u);
 }
 
 TEST(DalyBmsBleQueueTest, InvalidStartByteDoesNotAdvanceQueue) {
@@ -1118,6 +1238,23 @@ TEST(DalyBmsBleQueueTest, InvalidStartByteDoesNotAdvanceQueue) {
   EXPECT_EQ(bms.queue_size(), 1);
 }
 
+TEST(DalyBmsBleQueueTest, ShortFramesAreRejected) {
+  TestableDalyBmsBle bms;
+  bms.queue_sent_command_(0x06, 0x00A5, 0x0000);
+
+  bms.on_daly_bms_ble_data(std::vector<uint8_t>{});
+  bms.on_daly_bms_ble_data({0xD2, 0x03, 0x00});
+  // A valid CRC over a write echo without address and value
+  std::vector<uint8_t> echo = {0xD2, 0x06, 0x00};
+  const uint16_t crc = crc16(echo.data(), echo.size());
+  echo.push_back(crc & 0xFF);
+  echo.push_back(crc >> 8);
+  bms.on_daly_bms_ble_data(echo);
+
+  EXPECT_EQ(bms.queue_size(), 1);
+  EXPECT_EQ(bms.get_command_successes(), 0u);
+}
+
 TEST(DalyBmsBleQueueTest, BadCrcDoesNotAdvanceQueue) {
   TestableDalyBmsBle bms;
   bms.queue_command_(0x03, 0x0000, 62);
@@ -1129,63 +1266,1032 @@ TEST(DalyBmsBleQueueTest, BadCrcDoesNotAdvanceQueue) {
   EXPECT_EQ(bms.queue_size(), 1);
 }
 
-// ── Online status tracker ─────────────────────────────────────────────────────
+TEST(DalyBmsBleQueueTest, DefaultDepthAllowsOneCommandInFlight) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.enqueue(0x03, 0x0000, 62);
+  queue.enqueue(0x03, 0x0080, 41);
 
-TEST(DalyBmsBleOnlineStatusTrackerTest, ReachesThreshold) {
-  TestableDalyBmsBle bms;
-  binary_sensor::BinarySensor online_status;
-  bms.set_online_status_binary_sensor(&online_status);
+  ASSERT_TRUE(queue.can_send());
+  queue.mark_pending(0, 3000);
+  EXPECT_FALSE(queue.can_send());
+  EXPECT_EQ(queue.in_flight(), 1);
+}
 
-  for (int i = 0; i < 10; i++)
-    bms.track_online_status_();
+TEST(DalyBmsBleQueueTest, PipelineDepthLimitsCommandsInFlight) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.set_depth(3);
+  for (uint8_t i = 0; i < 5; i++)
+    queue.enqueue(0x03, i, 1);
 
-  EXPECT_FALSE(online_status.state);
+  while (queue.can_send())
+    queue.mark_pending(0, 3000);
+
+  EXPECT_EQ(queue.in_flight(), 3);
+  EXPECT_EQ(queue.next_unsent().address, 0x0003);
 }
 
-TEST(DalyBmsBleOnlineStatusTrackerTest, DoesNotRepeatAfterThreshold) {
+TEST(DalyBmsBleQueueTest, StatusResponseWithOtherRegisterCountIsMatchedInPipeline) {
   TestableDalyBmsBle bms;
-  binary_sensor::BinarySensor online_status;
-  bms.set_online_status_binary_sensor(&online_status);
+  sensor::Sensor voltage;
+  bms.set_total_voltage_sensor(&voltage);
+  bms.set_pipeline_depth(2);
+  bms.queue_command_(0x03, 0x0000, 80);
+  bms.queue_command_(0x03, 0x0080, 41);
+  bms.connect_sink_link_();
+  ASSERT_EQ(bms.get_queue().in_flight(), 2);
 
-  for (int i = 0; i < 10; i++)
-    bms.track_online_status_();
-  EXPECT_EQ(bms.get_no_response_count(), 11);
+  // An 80 register request answered with 62 registers while the settings read is in flight as well
+  bms.on_daly_bms_ble_data(STATUS_FRAME_62_REG_NO_ALARMS);
 
-  bms.track_online_status_();
-  EXPECT_EQ(bms.get_no_response_count(), 11);
+  EXPECT_FLOAT_EQ(voltage.state, 27.1f);
+  EXPECT_EQ(bms.get_command_successes(), 1u);
+  ASSERT_EQ(bms.queue_size(), 1);
+  EXPECT_EQ(bms.get_queue().at(0).address, 0x0080);
 }
 
-TEST(DalyBmsBleOnlineStatusTrackerTest, ResetRestoresOnlineStatus) {
+TEST(DalyBmsBleQueueTest, ResponseMatchedByDataLength) {
   TestableDalyBmsBle bms;
-  binary_sensor::BinarySensor online_status;
-  bms.set_online_status_binary_sensor(&online_status);
+  bms.set_pipeline_depth(3);
+  bms.queue_command_(0x03, 0x0000, 62);
+  bms.queue_command_(0x03, 0x0080, 41);
+  bms.queue_command_(0x03, 0x00CF, 1);
 
-  for (int i = 0; i < 10; i++)
-    bms.track_online_status_();
-  EXPECT_FALSE(online_status.state);
+  auto &queue = bms.get_queue();
+  while (queue.can_send())
+    queue.mark_pending(0, 3000);
 
-  bms.reset_online_status_tracker_();
-  EXPECT_TRUE(online_status.state);
-  EXPECT_EQ(bms.get_no_response_count(), 0);
+  TestSwitch balancer;
+  bms.set_balancer_switch(&balancer);
+
+  // The balancer switch response overtakes the outstanding status and settings reads
+  bms.on_daly_bms_ble_data(BALANCER_SWITCH_FRAME_ON);
+
+  EXPECT_TRUE(balancer.state);
+  ASSERT_EQ(bms.queue_size(), 2);
+  EXPECT_EQ(queue.in_flight(), 2);
+  EXPECT_EQ(queue.at(0).address, 0x0000);
+  EXPECT_EQ(queue.at(1).address, 0x0080);
 }
 
-TEST(DalyBmsBleOnlineStatusTrackerTest, CanRetriggerAfterReset) {
+TEST(DalyBmsBleQueueTest, WriteEchoMatchedByRegisterAddress) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.set_depth(2);
+  queue.enqueue(0x06, 0x00A1, 0x0001);
+  queue.enqueue(0x06, 0x00A2, 0x0000);
+  queue.mark_pending(0, 3000);
+  queue.mark_pending(0, 3000);
+
+  const uint8_t echo[] = {0xD2, 0x06, 0x00, 0xA2, 0x00, 0x00, 0x00, 0x00};
+  EXPECT_EQ(queue.match(echo, sizeof(echo)), 1);
+}
+
+TEST(DalyBmsBleQueueTest, UnmatchedResponseIsAttributedToOnlyReadInFlight) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.set_depth(2);
+  queue.enqueue(0x03, 0x0000, 62);
+  queue.enqueue(0x03, 0x0080, 41);
+  queue.mark_pending(0, 3000);
+
+  // A 62 register request answered with 80 registers
+  EXPECT_EQ(queue.match(STATUS_FRAME_80_REG_2.data(), STATUS_FRAME_80_REG_2.size()), 0);
+}
+
+TEST(DalyBmsBleQueueTest, OtherStatusLengthMatchesOnlyStatusReadInFlight) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.set_depth(2);
+  queue.enqueue(0x03, 0x0000, 62);
+  queue.enqueue(0x03, 0x0080, 41);
+  queue.mark_pending(0, 3000);
+  queue.mark_pending(0, 3000);
+
+  EXPECT_EQ(queue.match(STATUS_FRAME_80_REG_2.data(), STATUS_FRAME_80_REG_2.size()), 0);
+}
+
+TEST(DalyBmsBleQueueTest, AmbiguousResponseMatchesNothing) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.set_depth(2);
+  queue.enqueue(0x03, 0x0080, 41);
+  queue.enqueue(0x03, 0x00CF, 1);
+  queue.mark_pending(0, 3000);
+  queue.mark_pending(0, 3000);
+
+  // 4 registers were requested by neither read
+  const uint8_t frame[] = {0xD2, 0x03, 0x08, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  EXPECT_EQ(queue.match(frame, sizeof(frame)), TestableDalyBmsBle::CommandQueue::NO_MATCH);
+}
+
+TEST(DalyBmsBleQueueTest, NothingInFlightMatchesNothing) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.enqueue(0x03, 0x0000, 80);
+
+  EXPECT_EQ(queue.match(STATUS_FRAME_80_REG_2.data(), STATUS_FRAME_80_REG_2.size()),
+            TestableDalyBmsBle::CommandQueue::NO_MATCH);
+}
+
+TEST(DalyBmsBleQueueTest, TimeoutTracksOldestCommandInFlight) {
+  TestableDalyBmsBle::CommandQueue queue;
+  queue.set_depth(2);
+  queue.enqueue(0x03, 0x0000, 62);
+  queue.enqueue(0x03, 0x0080, 41);
+  queue.mark_pending(1000, 100);
+  queue.mark_pending(1050, 100);
+
+  EXPECT_FALSE(queue.timed_out(1100));
+  EXPECT_TRUE(queue.timed_out(1101));
+
+  queue.remove(0);
+  EXPECT_EQ(queue.in_flight(), 1);
+  EXPECT_FALSE(queue.timed_out(1150));
+  EXPECT_TRUE(queue.timed_out(1151));
+}
+
+TEST(DalyBmsBleQueueTest, WriteOvertakesQueuedReads) {
   TestableDalyBmsBle bms;
-  binary_sensor::BinarySensor online_status;
-  bms.set_online_status_binary_sensor(&online_status);
+  bms.queue_command_(0x03, 0x0000, 62);
+  bms.queue_command_(0x03, 0x0080, 41);
+  bms.queue_command_(0x06, 0x00A5, 0x0000);
 
-  for (int i = 0; i < 10; i++)
-    bms.track_online_status_();
-  bms.reset_online_status_tracker_();
+  auto &queue = bms.get_queue();
+  ASSERT_EQ(bms.queue_size(), 3);
+  EXPECT_EQ(queue.at(0).address, 0x00A5);
+  EXPECT_EQ(queue.at(1).address, 0x0000);
+  EXPECT_EQ(queue.at(2).address, 0x0080);
+}
 
-  for (int i = 0; i < 10; i++)
-    bms.track_online_status_();
-  EXPECT_FALSE(online_status.state);
+TEST(DalyBmsBleQueueTest, WritesKeepTheirOrder) {
+  TestableDalyBmsBle bms;
+  bms.queue_command_(0x03, 0x0000, 62);
+  bms.queue_command_(0x06, 0x00A5, 0x0000);
+  bms.queue_command_(0x06, 0x00A6, 0x0000);
+
+  auto &queue = bms.get_queue();
+  EXPECT_EQ(queue.at(0).address, 0x00A5);
+  EXPECT_EQ(queue.at(1).address, 0x00A6);
+  EXPECT_EQ(queue.at(2).address, 0x0000);
 }
 
-TEST(DalyBmsBleOnlineStatusTrackerTest, ValidFrameResetsCounter) {
+TEST(DalyBmsBleQueueTest, WriteQueuedBehindCommandInFlight) {
   TestableDalyBmsBle bms;
   bms.queue_command_(0x03, 0x0000, 62);
+  bms.queue_command_(0x03, 0x0080, 41);
+  auto &queue = bms.get_queue();
+  queue.mark_pending(0, 3000);
+
+  bms.queue_command_(0x06, 0x00A5, 0x0000);
+
+  EXPECT_EQ(queue.at(0).address, 0x0000);
+  EXPECT_EQ(queue.at(1).address, 0x00A5);
+  EXPECT_EQ(queue.next_unsent().address, 0x00A5);
+}
+
+TEST(DalyBmsBleQueueTest, FullQueueEvictsNewestReadForWrite) {
+  TestableDalyBmsBle bms;
+  const uint8_t max_size = TestableDalyBmsBle::CommandQueue::LENGTH - 1;
+  for (uint8_t i = 0; i < max_size; i++)
+    bms.queue_command_(0x03, i, 0);
+
+  bms.queue_command_(0x06, 0x00A5, 0x0000);
+
+  auto &queue = bms.get_queue();
+  ASSERT_EQ(bms.queue_size(), max_size);
+  EXPECT_EQ(queue.at(0).address, 0x00A5);
+  EXPECT_EQ(queue.at(max_size - 1).address, max_size - 2);
+}
+
+TEST(DalyBmsBleQueueTest, FullQueueOfWritesDropsWrite) {
+  TestableDalyBmsBle bms;
+  const uint8_t max_size = TestableDalyBmsBle::CommandQueue::LENGTH - 1;
+  for (uint8_t i = 0; i < max_size; i++)
+    bms.queue_command_(0x06, i, 0);
+
+  bms.queue_command_(0x06, 0x00A5, 0x0000);
+
+  EXPECT_EQ(bms.queue_size(), max_size);
+  EXPECT_EQ(bms.get_queue().at(max_size - 1).address, max_size - 1);
+}
+
+// ── Round trip time ──────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleRoundTripTimerTest, ConfiguredTimeoutWithoutSamples) {
+  TestableDalyBmsBle bms;
+  bms.set_response_timeout(5000);
+  EXPECT_EQ(bms.get_round_trip_timer().timeout_ms(0x03, 0x0000), 5000);
+  EXPECT_FALSE(bms.get_round_trip_timer().has_samples());
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, FirstSampleInitializesEstimate) {
+  TestableDalyBmsBle::RoundTripTimer timer;
+  timer.sample(0x03, 0x0000, 400);
+
+  // RTO = SRTT + 4 * RTTVAR = 400 + 4 * 200
+  EXPECT_EQ(timer.timeout_ms(0x03, 0x0000), 1200);
+  EXPECT_EQ(timer.smoothed_rtt_ms(), 400);
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, StableLinkConvergesTowardsRtt) {
+  TestableDalyBmsBle::RoundTripTimer timer;
+  for (int i = 0; i < 50; i++)
+    timer.sample(0x03, 0x0000, 400);
+
+  EXPECT_EQ(timer.smoothed_rtt_ms(), 400);
+  EXPECT_LT(timer.timeout_ms(0x03, 0x0000), 450);
+  EXPECT_GE(timer.timeout_ms(0x03, 0x0000), 400);
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, TimeoutBoundedByConfiguredValue) {
+  TestableDalyBmsBle::RoundTripTimer timer;
+  timer.set_max_timeout_ms(1000);
+  timer.sample(0x03, 0x0000, 900);
+
+  EXPECT_EQ(timer.timeout_ms(0x03, 0x0000), 1000);
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, TimeoutHasLowerBound) {
+  TestableDalyBmsBle::RoundTripTimer timer;
+  for (int i = 0; i < 50; i++)
+    timer.sample(0x03, 0x0000, 10);
+
+  EXPECT_EQ(timer.timeout_ms(0x03, 0x0000), TestableDalyBmsBle::RoundTripTimer::MIN_TIMEOUT_MS);
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, EstimatesTrackedPerCommandType) {
+  TestableDalyBmsBle::RoundTripTimer timer;
+  timer.set_max_timeout_ms(3000);
+  timer.sample(0x03, 0x0000, 600);
+  timer.sample(0x03, 0x00CF, 100);
+
+  EXPECT_EQ(timer.timeout_ms(0x03, 0x0000), 1800);
+  EXPECT_EQ(timer.timeout_ms(0x03, 0x00CF), 300);
+  EXPECT_EQ(timer.timeout_ms(0x03, 0x0080), 3000);
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, WritesShareOneEstimate) {
+  TestableDalyBmsBle::RoundTripTimer timer;
+  timer.sample(0x06, 0x00A5, 200);
+
+  EXPECT_EQ(timer.timeout_ms(0x06, 0x00A6), 600);
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, BackoffDoublesTimeoutUpToLimit) {
+  TestableDalyBmsBle::RoundTripTimer timer;
+  timer.set_max_timeout_ms(3000);
+  timer.sample(0x03, 0x0000, 400);
+
+  timer.backoff(0x03, 0x0000);
+  EXPECT_EQ(timer.timeout_ms(0x03, 0x0000), 2400);
+  timer.backoff(0x03, 0x0000);
+  EXPECT_EQ(timer.timeout_ms(0x03, 0x0000), 3000);
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, ResponseToCommandInFlightIsSampled) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor round_trip_time;
+  bms.set_round_trip_time_sensor(&round_trip_time);
+  bms.queue_command_(0x03, 0x00CF, 1);
+  bms.get_queue().mark_pending(millis(), 3000);
+
+  bms.on_daly_bms_ble_data(BALANCER_SWITCH_FRAME_ON);
+  EXPECT_TRUE(bms.get_round_trip_timer().has_samples());
+
+  bms.update();
+  EXPECT_TRUE(round_trip_time.has_state());
+}
+
+TEST(DalyBmsBleRoundTripTimerTest, ResponseToUnsentCommandIsNotSampled) {
+  TestableDalyBmsBle bms;
+  bms.queue_command_(0x03, 0x00CF, 1);
+
+  bms.on_daly_bms_ble_data(BALANCER_SWITCH_FRAME_ON);
+
+  EXPECT_FALSE(bms.get_round_trip_timer().has_samples());
+}
+
+TEST(DalyBmsBleSchedulerTest, QueuedReadIsNotQueuedAgain) {
+  TestableDalyBmsBle bms;
+  EXPECT_TRUE(bms.queue_sent_command_(0x03, 0x00CF, 1));
+  EXPECT_TRUE(bms.queue_sent_command_(0x03, 0x00CF, 1));
+  EXPECT_EQ(bms.queue_size(), 1);
+
+  bms.queue_sent_command_(0x06, 0x00A5, 0x0000);
+  bms.queue_sent_command_(0x06, 0x00A5, 0x0000);
+  EXPECT_EQ(bms.queue_size(), 3);
+}
+
+TEST(DalyBmsBleSchedulerTest, SlowLinkDoesNotFillQueueWithDuplicates) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor overruns;
+  bms.set_poll_cycle_overruns_sensor(&overruns);
+
+  // No responses arrive, every update interval starts a new poll cycle
+  for (uint32_t now = 0; now < 20 * 10000; now += 10000)
+    bms.queue_poll_blocks_(now);
+
+  EXPECT_EQ(bms.queue_size(), 3);
+  bms.update();
+  EXPECT_FLOAT_EQ(overruns.state, 19.0f);
+}
+
+// ── Retries ──────────────────────────────────────────────────────────────────
+
+// Sends the next command of the queue and lets it time out
+static void time_out_next_command(TestableDalyBmsBle &bms) {
+  bms.get_queue().mark_pending(millis(), 100);
+  delay(101);
+  bms.loop();
+}
+
+TEST(DalyBmsBleRetryTest, TimedOutReadIsRequeuedWithBackoff) {
+  TestableDalyBmsBle bms;
+  bms.queue_command_(0x03, 0x00CF, 1);
+  time_out_next_command(bms);
+
+  auto &queue = bms.get_queue();
+  ASSERT_EQ(bms.queue_size(), 1);
+  EXPECT_EQ(queue.in_flight(), 0);
+  EXPECT_EQ(queue.at(0).attempts, 1);
+  EXPECT_EQ(queue.at(0).backoff_ms, 100);
+  EXPECT_FALSE(queue.ready(millis() + 99));
+  EXPECT_TRUE(queue.ready(millis() + 100));
+}
+
+TEST(DalyBmsBleRetryTest, BackoffDoublesWithEveryRetry) {
+  TestableDalyBmsBle bms;
+  bms.set_retry_backoff(50);
+  bms.queue_command_(0x06, 0x00A5, 0x0000);
+
+  time_out_next_command(bms);
+  EXPECT_EQ(bms.get_queue().at(0).backoff_ms, 50);
+  time_out_next_command(bms);
+  EXPECT_EQ(bms.get_queue().at(0).backoff_ms, 100);
+  time_out_next_command(bms);
+  EXPECT_EQ(bms.get_queue().at(0).backoff_ms, 200);
+}
+
+TEST(DalyBmsBleRetryTest, ReadIsDroppedWhenRetriesExhausted) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor retries, failures;
+  bms.set_command_retries_sensor(&retries);
+  bms.set_command_failures_sensor(&failures);
+  bms.set_read_retries(1);
+  bms.queue_command_(0x03, 0x00CF, 1);
+
+  time_out_next_command(bms);
+  EXPECT_EQ(bms.queue_size(), 1);
+  time_out_next_command(bms);
+  EXPECT_EQ(bms.queue_size(), 0);
+
+  bms.update();
+  EXPECT_FLOAT_EQ(retries.state, 1.0f);
+  EXPECT_FLOAT_EQ(failures.state, 1.0f);
+}
+
+TEST(DalyBmsBleRetryTest, WritesHaveLargerRetryBudgetThanReads) {
+  TestableDalyBmsBle read, write;
+  read.queue_command_(0x03, 0x00CF, 1);
+  write.queue_command_(0x06, 0x00A5, 0x0000);
+
+  for (uint8_t i = 0; i < 3; i++) {
+    time_out_next_command(read);
+    time_out_next_command(write);
+  }
+  EXPECT_EQ(read.queue_size(), 0);
+  EXPECT_EQ(write.queue_size(), 1);
+
+  for (uint8_t i = 0; i < 3; i++)
+    time_out_next_command(write);
+  EXPECT_EQ(write.queue_size(), 0);
+}
+
+TEST(DalyBmsBleRetryTest, RequeuedCommandFollowsCommandsInFlight) {
+  TestableDalyBmsBle bms;
+  bms.set_pipeline_depth(2);
+  bms.queue_command_(0x03, 0x0000, 62);
+  bms.queue_command_(0x03, 0x0080, 41);
+  bms.queue_command_(0x03, 0x00CF, 1);
+  auto &queue = bms.get_queue();
+  queue.mark_pending(millis(), 100);
+  queue.mark_pending(millis() + 50, 100);
+
+  delay(101);
+  bms.loop();
+
+  ASSERT_EQ(bms.queue_size(), 3);
+  EXPECT_EQ(queue.in_flight(), 1);
+  EXPECT_EQ(queue.at(0).address, 0x0080);
+  EXPECT_EQ(queue.at(1).address, 0x0000);
+  EXPECT_EQ(queue.at(2).address, 0x00CF);
+}
+
+TEST(DalyBmsBleRetryTest, ResponseToRetriedCommandIsNotSampled) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor successes;
+  bms.set_command_successes_sensor(&successes);
+  bms.queue_command_(0x03, 0x00CF, 1);
+  time_out_next_command(bms);
+  bms.get_queue().mark_pending(millis(), 3000);
+
+  bms.on_daly_bms_ble_data(BALANCER_SWITCH_FRAME_ON);
+
+  EXPECT_EQ(bms.queue_size(), 0);
+  EXPECT_FALSE(bms.get_round_trip_timer().has_samples());
+  bms.update();
+  EXPECT_FLOAT_EQ(successes.state, 1.0f);
+}
+
+// ── Poll scheduler ───────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleSchedulerTest, FirstCycleQueuesAllBlocks) {
+  TestableDalyBmsBle bms;
+  bms.queue_poll_blocks_(0);
+
+  auto &queue = bms.get_queue();
+  ASSERT_EQ(bms.queue_size(), 3);
+  EXPECT_EQ(queue.at(0).address, 0x0000);
+  EXPECT_EQ(queue.at(0).value, 62);
+  EXPECT_EQ(queue.at(1).address, 0x0080);
+  EXPECT_EQ(queue.at(2).address, 0x00CF);
+}
+
+TEST(DalyBmsBleSchedulerTest, StatusRegistersFollowConfiguration) {
+  TestableDalyBmsBle bms;
+  bms.set_status_registers(80);
+  bms.queue_poll_blocks_(0);
+
+  EXPECT_EQ(bms.get_queue().at(0).value, 80);
+}
+
+TEST(DalyBmsBleSchedulerTest, SettingsPolledAtSlowInterval) {
+  TestableDalyBmsBle bms;
+  bms.set_settings_update_interval(300000);
+  bms.queue_poll_blocks_(0);
+  bms.reset_queue();
+
+  bms.queue_poll_blocks_(10000);
+  ASSERT_EQ(bms.queue_size(), 1);
+  EXPECT_EQ(bms.get_queue().at(0).address, 0x0000);
+  bms.reset_queue();
+
+  bms.queue_poll_blocks_(300000);
+  EXPECT_EQ(bms.queue_size(), 3);
+}
+
+TEST(DalyBmsBleSchedulerTest, WriteInvalidatesContainingBlock) {
+  TestableDalyBmsBle bms;
+  bms.queue_poll_blocks_(0);
+  bms.reset_queue();
+
+  // Charging MOSFET switch lives in the settings block 0x0080-0x00A8
+  bms.send_command(0x06, 0x00A5, 0x0001);
+  bms.reset_queue();
+
+  bms.queue_poll_blocks_(10000);
+  auto &queue = bms.get_queue();
+  ASSERT_EQ(bms.queue_size(), 2);
+  EXPECT_EQ(queue.at(0).address, 0x0000);
+  EXPECT_EQ(queue.at(1).address, 0x0080);
+}
+
+TEST(DalyBmsBleSchedulerTest, InvalidateRequeuesAllBlocks) {
+  TestableDalyBmsBle bms;
+  bms.queue_poll_blocks_(0);
+  bms.reset_queue();
+
+  bms.invalidate_poll_blocks_();
+  bms.queue_poll_blocks_(10000);
+
+  EXPECT_EQ(bms.queue_size(), 3);
+}
+
+// ── Notification reassembly ──────────────────────────────────────────────────
+
+static void notify_in_fragments(TestableDalyBmsBle &bms, const std::vector<uint8_t> &frame, size_t fragment_size) {
+  for (size_t i = 0; i < frame.size(); i += fragment_size)
+    bms.on_daly_bms_ble_notify(frame.data() + i, std::min(fragment_size, frame.size() - i));
+}
+
+TEST(DalyBmsBleReassemblyTest, CompleteFrameInOneNotification) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor total_voltage;
+  bms.set_total_voltage_sensor(&total_voltage);
+  bms.queue_sent_command_(0x03, 0x0000, 80);
+
+  bms.on_daly_bms_ble_notify(STATUS_FRAME_80_REG_2.data(), STATUS_FRAME_80_REG_2.size());
+
+  EXPECT_TRUE(total_voltage.has_state());
+  EXPECT_EQ(bms.queue_size(), 0);
+}
+
+TEST(DalyBmsBleReassemblyTest, FrameSplitAtDefaultMtu) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor total_voltage;
+  bms.set_total_voltage_sensor(&total_voltage);
+  bms.queue_sent_command_(0x03, 0x0000, 80);
+
+  // ATT MTU 23 leaves 20 bytes of payload per notification
+  notify_in_fragments(bms, STATUS_FRAME_80_REG_2, 20);
+
+  EXPECT_TRUE(total_voltage.has_state());
+  EXPECT_EQ(bms.queue_size(), 0);
+}
+
+TEST(DalyBmsBleReassemblyTest, SingleByteFragments) {
+  TestableDalyBmsBle bms;
+  TestSwitch balancer;
+  bms.set_balancer_switch(&balancer);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
+
+  notify_in_fragments(bms, BALANCER_SWITCH_FRAME_ON, 1);
+
+  EXPECT_TRUE(balancer.state);
+}
+
+TEST(DalyBmsBleReassemblyTest, IncompleteFrameIsNotDispatched) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor total_voltage;
+  bms.set_total_voltage_sensor(&total_voltage);
+  bms.queue_sent_command_(0x03, 0x0000, 80);
+
+  bms.on_daly_bms_ble_notify(STATUS_FRAME_80_REG_2.data(), 100);
+
+  EXPECT_FALSE(total_voltage.has_state());
+  EXPECT_EQ(bms.queue_size(), 1);
+}
+
+TEST(DalyBmsBleReassemblyTest, LeadingGarbageIsSkipped) {
+  TestableDalyBmsBle bms;
+  TestSwitch balancer;
+  bms.set_balancer_switch(&balancer);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
+
+  std::vector<uint8_t> data = {0x00, 0x11, 0x22};
+  data.insert(data.end(), BALANCER_SWITCH_FRAME_ON.begin(), BALANCER_SWITCH_FRAME_ON.end());
+  bms.on_daly_bms_ble_notify(data.data(), data.size());
+
+  EXPECT_TRUE(balancer.state);
+}
+
+TEST(DalyBmsBleReassemblyTest, StrayStartByteIsSkipped) {
+  TestableDalyBmsBle bms;
+  TestSwitch balancer;
+  bms.set_balancer_switch(&balancer);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
+
+  // 0xD2 0x55 is not a plausible header
+  std::vector<uint8_t> data = {0xD2, 0x55};
+  data.insert(data.end(), BALANCER_SWITCH_FRAME_ON.begin(), BALANCER_SWITCH_FRAME_ON.end());
+  bms.on_daly_bms_ble_notify(data.data(), data.size());
+
+  EXPECT_TRUE(balancer.state);
+}
+
+TEST(DalyBmsBleReassemblyTest, ResyncAfterCorruptedFrame) {
+  TestableDalyBmsBle bms;
+  TestSwitch balancer;
+  bms.set_balancer_switch(&balancer);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
+
+  auto corrupted = BALANCER_SWITCH_FRAME_ON;
+  corrupted[5] ^= 0x01;
+  bms.on_daly_bms_ble_notify(corrupted.data(), corrupted.size());
+  EXPECT_FALSE(balancer.state);
+  EXPECT_EQ(bms.queue_size(), 1);
+
+  bms.on_daly_bms_ble_notify(BALANCER_SWITCH_FRAME_ON.data(), BALANCER_SWITCH_FRAME_ON.size());
+  EXPECT_TRUE(balancer.state);
+}
+
+TEST(DalyBmsBleReassemblyTest, TwoFramesInOneNotification) {
+  TestableDalyBmsBle bms;
+  TestSwitch balancer;
+  bms.set_balancer_switch(&balancer);
+  bms.set_pipeline_depth(2);
+  // Two reads of the balancer register in flight, a queued identical read would be coalesced
+  bms.get_queue().enqueue(0x03, 0x00CF, 1);
+  bms.get_queue().enqueue(0x03, 0x00CF, 1);
+  bms.get_queue().mark_pending(0, 3000);
+  bms.get_queue().mark_pending(0, 3000);
+
+  std::vector<uint8_t> data(BALANCER_SWITCH_FRAME_OFF);
+  data.insert(data.end(), BALANCER_SWITCH_FRAME_ON.begin(), BALANCER_SWITCH_FRAME_ON.end());
+  bms.on_daly_bms_ble_notify(data.data(), data.size());
+
+  EXPECT_TRUE(balancer.state);
+  EXPECT_EQ(bms.queue_size(), 0);
+}
+
+TEST(DalyBmsBleReassemblyTest, WriteEchoIsEightBytes) {
+  TestableDalyBmsBle bms;
+  bms.queue_sent_command_(0x06, 0x00CF, 1);
+
+  auto echo = bms.build_frame_(0x06, 0x00CF, 1);
+  bms.on_daly_bms_ble_notify(echo.data(), 5);
+  EXPECT_EQ(bms.queue_size(), 1);
+  bms.on_daly_bms_ble_notify(echo.data() + 5, 3);
+  EXPECT_EQ(bms.queue_size(), 0);
+}
+
+TEST(DalyBmsBleReassemblyTest, StalePartialFrameIsDiscarded) {
+  TestableDalyBmsBle bms;
+  TestSwitch balancer;
+  bms.set_balancer_switch(&balancer);
+  bms.set_response_timeout(1);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
+
+  bms.on_daly_bms_ble_notify(BALANCER_SWITCH_FRAME_ON.data(), 4);
+  delay(5);
+  bms.on_daly_bms_ble_notify(BALANCER_SWITCH_FRAME_ON.data() + 4, 3);
+
+  EXPECT_FALSE(balancer.state);
+  EXPECT_EQ(bms.queue_size(), 1);
+}
+
+// ── Publish on change ────────────────────────────────────────────────────────
+
+TEST(DalyBmsBlePublishOnChangeTest, WithoutHeartbeatUnchangedValuesAreSuppressed) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor voltage;
+  bms.set_total_voltage_sensor(&voltage);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+
+  EXPECT_EQ(voltage.publish_count, 1);
+}
+
+TEST(DalyBmsBlePublishOnChangeTest, WithoutHeartbeatChangeWithinDeadbandIsSuppressed) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor cell1;
+  bms.set_cell_voltage_sensor(0, &cell1);
+  bms.set_cell_voltage_deadband(0.002f);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  auto frame = STATUS_FRAME_62_REG_NO_ALARMS;
+  frame[4] += 1;  // +1 mV
+  bms.decode_status_data_(frame);
+
+  EXPECT_EQ(cell1.publish_count, 1);
+  EXPECT_NEAR(cell1.state, 3.438f, 0.0001f);
+}
+
+TEST(DalyBmsBlePublishOnChangeTest, UnchangedValuesAreSuppressed) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor voltage;
+  text_sensor::TextSensor status;
+  bms.set_total_voltage_sensor(&voltage);
+  bms.set_battery_status_text_sensor(&status);
+  bms.set_heartbeat_interval(60000);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+
+  EXPECT_EQ(voltage.publish_count, 1);
+  EXPECT_EQ(status.publish_count, 1);
+}
+
+TEST(DalyBmsBlePublishOnChangeTest, ChangeWithinDeadbandIsSuppressed) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor cell1;
+  bms.set_cell_voltage_sensor(0, &cell1);
+  bms.set_heartbeat_interval(60000);
+  bms.set_cell_voltage_deadband(0.002f);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  auto frame = STATUS_FRAME_62_REG_NO_ALARMS;
+  frame[4] += 2;  // +2 mV
+  bms.decode_status_data_(frame);
+  EXPECT_EQ(cell1.publish_count, 1);
+  EXPECT_NEAR(cell1.state, 3.438f, 0.0001f);
+
+  frame[4] += 1;  // +3 mV against the published value
+  bms.decode_status_data_(frame);
+  EXPECT_EQ(cell1.publish_count, 2);
+  EXPECT_NEAR(cell1.state, 3.441f, 0.0001f);
+}
+
+TEST(DalyBmsBlePublishOnChangeTest, HeartbeatRepublishesUnchangedValues) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor voltage;
+  bms.set_total_voltage_sensor(&voltage);
+  bms.set_heartbeat_interval(60000);
+
+  bms.update();
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  delay(30000);
+  bms.update();
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  EXPECT_EQ(voltage.publish_count, 1);
+
+  delay(30000);
+  bms.update();
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  EXPECT_EQ(voltage.publish_count, 2);
+}
+
+TEST(DalyBmsBlePublishOnChangeTest, UnavailableIsPublishedOnce) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor voltage;
+  bms.set_total_voltage_sensor(&voltage);
+  bms.set_heartbeat_interval(60000);
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  bms.publish_device_unavailable_();
+  bms.publish_device_unavailable_();
+
+  EXPECT_TRUE(std::isnan(voltage.state));
+  EXPECT_EQ(voltage.publish_count, 2);
+}
+
+// ── Snapshot ─────────────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleSnapshotTest, HoldsRawValuesOfStatusFrame) {
+  TestableDalyBmsBle bms;
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+
+  const auto &snapshot = bms.get_snapshot();
+  EXPECT_EQ(snapshot.total_voltage, 271);
+  EXPECT_EQ(snapshot.current, 30000);
+  EXPECT_EQ(snapshot.state_of_charge, 1000);
+  EXPECT_EQ(snapshot.cell_count, 8);
+  EXPECT_EQ(snapshot.alarms, 0u);
+  EXPECT_TRUE(snapshot.has(BmsSnapshot::TOTAL_VOLTAGE | BmsSnapshot::CELL_VOLTAGES | BmsSnapshot::ALARMS));
+}
+
+TEST(DalyBmsBleSnapshotTest, HoldsCellsAndTemperaturesWithoutTheirSensors) {
+  TestableDalyBmsBle bms;
+
+  bms.decode_status_data_(STATUS_FRAME_80_REG_2);
+
+  const auto &snapshot = bms.get_snapshot();
+  ASSERT_TRUE(snapshot.has(BmsSnapshot::CELL_VOLTAGES | BmsSnapshot::TEMPERATURES));
+  EXPECT_EQ(snapshot.cell_count, 16);
+  EXPECT_EQ(snapshot.temperature_count, 4);
+  EXPECT_NE(snapshot.cell_voltages[15], 0);
+  EXPECT_NE(snapshot.temperatures[3], 0);
+}
+
+TEST(DalyBmsBleSnapshotTest, RegistersBeyondFrameAreNotFlagged) {
+  TestableDalyBmsBle bms;
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  EXPECT_FALSE(bms.get_snapshot().has(BmsSnapshot::BALANCE_CURRENT));
+
+  bms.decode_status_data_(STATUS_FRAME_80_REG_1);
+  EXPECT_TRUE(bms.get_snapshot().has(BmsSnapshot::BALANCE_CURRENT));
+}
+
+TEST(DalyBmsBleSnapshotTest, RejectedFrameLeavesSnapshotUnchanged) {
+  TestableDalyBmsBle bms;
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+  const uint32_t millis = bms.get_snapshot().millis;
+  delay(10);
+  bms.decode_status_data_(BALANCER_SWITCH_FRAME_ON);
+
+  EXPECT_EQ(bms.get_snapshot().millis, millis);
+  EXPECT_EQ(bms.get_snapshot().total_voltage, 271);
+}
+
+TEST(DalyBmsBleSnapshotTest, ReadSnapshotFailsBeforeFirstCycle) {
+  TestableDalyBmsBle bms;
+  BmsSnapshot snapshot;
+
+  EXPECT_FALSE(bms.read_snapshot(snapshot));
+}
+
+TEST(DalyBmsBleSnapshotTest, ReadSnapshotCopiesLastCycle) {
+  TestableDalyBmsBle bms;
+  BmsSnapshot snapshot;
+
+  bms.decode_status_data_(STATUS_FRAME_62_REG_NO_ALARMS);
+
+  ASSERT_TRUE(bms.read_snapshot(snapshot));
+  EXPECT_EQ(snapshot.total_voltage, 271);
+  EXPECT_EQ(snapshot.cell_count, 8);
+  EXPECT_EQ(snapshot.fields, bms.get_snapshot().fields);
+}
+
+TEST(DalyBmsBleSnapshotTest, ConcurrentReadsAreNeverTorn) {
+  TestableDalyBmsBle bms;
+  std::atomic<bool> done{false};
+
+  // Every cycle stores its number in all cells, a torn copy mixes two cycles
+  std::thread writer([&] {
+    for (uint16_t cycle = 1; cycle <= 20000; cycle++) {
+      auto &back = bms.snapshot_back_();
+      back.cell_count = 48;
+      std::fill(std::begin(back.cell_voltages), std::end(back.cell_voltages), cycle);
+      back.fields = BmsSnapshot::CELL_COUNT;
+      bms.commit_snapshot_();
+    }
+    done = true;
+  });
+
+  BmsSnapshot snapshot;
+  while (!done) {
+    if (!bms.read_snapshot(snapshot))
+      continue;
+    for (uint16_t cell_voltage : snapshot.cell_voltages)
+      ASSERT_EQ(cell_voltage, snapshot.cell_voltages[0]);
+  }
+  writer.join();
+
+  ASSERT_TRUE(bms.read_snapshot(snapshot));
+  EXPECT_EQ(snapshot.cell_voltages[47], 20000);
+}
+
+// ── Unchanged frames ─────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleUnchangedFrameTest, IdenticalSettingsFrameIsSkipped) {
+  TestableDalyBmsBle bms;
+  TestSwitch charging;
+  bms.set_charging_switch(&charging);
+
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+
+  EXPECT_EQ(charging.publish_count, 1);
+  EXPECT_EQ(bms.get_skipped_frames(), 1);
+  EXPECT_EQ(bms.queue_size(), 0);
+}
+
+TEST(DalyBmsBleUnchangedFrameTest, ChangedFrameIsDecoded) {
+  TestableDalyBmsBle bms;
+  TestSwitch balancer;
+  bms.set_balancer_switch(&balancer);
+
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
+  bms.on_daly_bms_ble_data(BALANCER_SWITCH_FRAME_ON);
+  bms.queue_sent_command_(0x03, 0x00CF, 1);
+  bms.on_daly_bms_ble_data(BALANCER_SWITCH_FRAME_OFF);
+
+  EXPECT_EQ(balancer.publish_count, 2);
+  EXPECT_FALSE(balancer.state);
+  EXPECT_EQ(bms.get_skipped_frames(), 0);
+}
+
+TEST(DalyBmsBleUnchangedFrameTest, RealtimeFramesAreAlwaysDecoded) {
+  TestableDalyBmsBle bms;
+  sensor::Sensor voltage;
+  bms.set_total_voltage_sensor(&voltage);
+
+  // The same frame again with a total voltage 0.1 V higher, the decode publishes it
+  auto frame = STATUS_FRAME_62_REG_NO_ALARMS;
+  frame[4 + 0x28 * 2] += 1;
+  auto crc = crc16(frame.data(), frame.size() - 2);
+  frame[frame.size() - 2] = crc & 0xFF;
+  frame[frame.size() - 1] = crc >> 8;
+  bms.queue_sent_command_(0x03, 0x0000, 62);
+  bms.on_daly_bms_ble_data(STATUS_FRAME_62_REG_NO_ALARMS);
+  bms.queue_sent_command_(0x03, 0x0000, 62);
+  bms.on_daly_bms_ble_data(frame);
+
+  EXPECT_EQ(voltage.publish_count, 2);
+  EXPECT_EQ(bms.get_skipped_frames(), 0);
+}
+
+TEST(DalyBmsBleUnchangedFrameTest, WriteToBlockForcesDecode) {
+  TestableDalyBmsBle bms;
+  TestSwitch charging;
+  bms.set_charging_switch(&charging);
+
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+  bms.send_command(0x06, 0x00A5, 0x0001);
+  bms.reset_queue();
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+
+  EXPECT_EQ(charging.publish_count, 2);
+  EXPECT_EQ(bms.get_skipped_frames(), 0);
+}
+
+TEST(DalyBmsBleUnchangedFrameTest, ExplicitReadForcesDecode) {
+  TestableDalyBmsBle bms;
+  TestSwitch charging;
+  bms.set_charging_switch(&charging);
+  bms.connect_sink_link_();
+
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+  bms.send_command(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+
+  EXPECT_EQ(charging.publish_count, 2);
+  EXPECT_EQ(bms.get_skipped_frames(), 0);
+}
+
+TEST(DalyBmsBleUnchangedFrameTest, NewConnectionDecodesEveryBlock) {
+  TestableDalyBmsBle bms;
+  TestSwitch charging;
+  bms.set_charging_switch(&charging);
+
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+  bms.on_transport_disconnected();
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+
+  EXPECT_EQ(charging.publish_count, 2);
+  EXPECT_EQ(bms.get_skipped_frames(), 0);
+}
+
+TEST(DalyBmsBleUnchangedFrameTest, DumpDiagnosticsRereadsSettings) {
+  TestableDalyBmsBle bms;
+  TestSwitch charging;
+  bms.set_charging_switch(&charging);
+
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+  ASSERT_EQ(bms.queue_size(), 0);
+
+  bms.dump_diagnostics();
+  EXPECT_GT(bms.queue_size(), 0);
+  bms.connect_sink_link_();
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+
+  EXPECT_EQ(charging.publish_count, 2);
+  EXPECT_EQ(bms.get_skipped_frames(), 0);
+}
+
+TEST(DalyBmsBleUnchangedFrameTest, SkippedFrameUpdatesOnlineStatus) {
+  TestableDalyBmsBle bms;
+  binary_sensor::BinarySensor online_status;
+  bms.set_online_status_binary_sensor(&online_status);
+
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+  for (int i = 0; i < 10; i++)
+    bms.track_online_status_();
+  ASSERT_FALSE(online_status.state);
+
+  bms.queue_sent_command_(0x03, 0x0080, 41);
+  bms.on_daly_bms_ble_data(SETTINGS_FRAME_1);
+
+  EXPECT_EQ(bms.get_skipped_frames(), 1);
+  EXPECT_TRUE(online_status.state);
+  EXPECT_EQ(bms.get_no_response_count(), 0);
+}
+
+// ── Online status tracker ─────────────────────────────────────────────────────
+
+TEST(DalyBmsBleOnlineStatusTrackerTest, ReachesThreshold) {
+  TestableDalyBmsBle bms;
+  binary_sensor::BinarySensor online_status;
+  bms.set_online_status_binary_sensor(&online_status);
+
+  for (int i = 0; i < 10; i++)
+    bms.track_online_status_();
+
+  EXPECT_FALSE(online_status.state);
+}
+
+TEST(DalyBmsBleOnlineStatusTrackerTest, DoesNotRepeatAfterThreshold) {
+  TestableDalyBmsBle bms;
+  binary_sensor::BinarySensor online_status;
+  bms.set_online_status_binary_sensor(&online_status);
+
+  for (int i = 0; i < 10; i++)
+    bms.track_online_status_();
+  EXPECT_EQ(bms.get_no_response_count(), 11);
+
+  bms.track_online_status_();
+  EXPECT_EQ(bms.get_no_response_count(), 11);
+}
+
+TEST(DalyBmsBleOnlineStatusTrackerTest, ResetRestoresOnlineStatus) {
+  TestableDalyBmsBle bms;
+  binary_sensor::BinarySensor online_status;
+  bms.set_online_status_binary_sensor(&online_status);
+
+  for (int i = 0; i < 10; i++)
+    bms.track_online_status_();
+  EXPECT_FALSE(online_status.state);
+
+  bms.reset_online_status_tracker_();
+  EXPECT_TRUE(online_status.state);
+  EXPECT_EQ(bms.get_no_response_count(), 0);
+}
+
+TEST(DalyBmsBleOnlineStatusTrackerTest, CanRetriggerAfterReset) {
+  TestableDalyBmsBle bms;
+  binary_sensor::BinarySensor online_status;
+  bms.set_online_status_binary_sensor(&online_status);
+
+  for (int i = 0; i < 10; i++)
+    bms.track_online_status_();
+  bms.reset_online_status_tracker_();
+
+  for (int i = 0; i < 10; i++)
+    bms.track_online_status_();
+  EXPECT_FALSE(online_status.state);
+}
+
+TEST(DalyBmsBleOnlineStatusTrackerTest, ValidFrameResetsCounter) {
+  TestableDalyBmsBle bms;
+  bms.queue_sent_command_(0x03, 0x0000, 62);
 
   for (int i = 0; i < 5; i++)
     bms.track_online_status_();
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include "common.h"
+#include "simulated_bms.h"
+
+namespace esphome::daly_bms_ble::testing {
+
+static const uint32_t UPDATE_INTERVAL = 5000;
+
+struct VirtualTimeBms {
+  ConfiguredBms configured;
+  SimulatedBms simulated;
+
+  explicit VirtualTimeBms(uint32_t seed = 1, uint32_t start_millis = 0)
+      : simulated(&configured.bms, 0xD2, seed, start_millis) {
+    configured.bms.set_status_registers(80);
+    simulated.load_frame(0x0000, STATUS_FRAME_80_REG_2);
+    simulated.load_frame(0x0080, SETTINGS_FRAME_1);
+    simulated.load_frame(0x00CF, BALANCER_SWITCH_FRAME_ON);
+  }
+
+  TestableDalyBmsBle &bms() { return configured.bms; }
+
+  // Runs poll cycles at the update interval, returns the number of cycles which didn't drain the queue in time
+  uint32_t run_cycles(uint32_t cycles) {
+    uint32_t incomplete = 0;
+    for (uint32_t i = 0; i < cycles; i++) {
+      const uint32_t start = simulated.clock().millis();
+      if (!run_poll_cycle(configured.bms, simulated, UPDATE_INTERVAL).completed)
+        incomplete++;
+      // Nothing happens between the cycles once all responses arrived, skip ahead
+      while (simulated.clock().millis() - start < UPDATE_INTERVAL) {
+        if (configured.bms.queue_size() == 0 && simulated.idle()) {
+          simulated.clock().advance(UPDATE_INTERVAL - (simulated.clock().millis() - start));
+          break;
+        }
+        step(configured.bms, simulated);
+      }
+    }
+    return incomplete;
+  }
+};
+
+// ── Timeouts ─────────────────────────────────────────────────────────────────
+
+TEST(DalyBmsBleVirtualTimeTest, TimeoutFiresAfterResponseTimeout) {
+  VirtualTimeBms sim;
+  sim.simulated.set_link({.loss = 1.0f});
+  sim.bms().update();
+  ASSERT_TRUE(sim.bms().command_pending());
+
+  // Without round trip samples the configured response timeout applies
+  for (int i = 0; i < 3000; i++)
+    step(sim.bms(), sim.simulated);
+  EXPECT_EQ(sim.bms().get_command_retries(), 0u);
+  step(sim.bms(), sim.simulated);
+  EXPECT_EQ(sim.bms().get_command_retries(), 1u);
+  EXPECT_FALSE(sim.bms().command_pending());
+
+  // Sent again once the retry backoff passed
+  for (int i = 0; i < 100; i++)
+    step(sim.bms(), sim.simulated);
+  EXPECT_TRUE(sim.bms().command_pending());
+  EXPECT_EQ(sim.simulated.stats().requests, 2u);
+}
+
+TEST(DalyBmsBleVirtualTimeTest, ResponseTimeoutFollowsRoundTripTime) {
+  VirtualTimeBms sim;
+  sim.simulated.set_link({.latency_ms = 400});
+  EXPECT_EQ(sim.run_cycles(50), 0u);
+
+  auto &timer = sim.bms().get_round_trip_timer();
+  EXPECT_NEAR(timer.smoothed_rtt_ms(), 400, 2);
+  const uint32_t timeout = timer.timeout_ms(0x03, 0x0000);
+  EXPECT_GE(timeout, 400u);
+  EXPECT_LT(timeout, 3000u);
+}
+
+TEST(DalyBmsBleVirtualTimeTest, TimeoutsSurviveMillisRollover) {
+  // The same link with the same seed, once with the clock wrapping around during the run
+  VirtualTimeBms reference(7);
+  VirtualTimeBms wrapping(7, 0xFFFFFFFF - 3 * UPDATE_INTERVAL);
+  for (auto *sim : {&reference, &wrapping}) {
+    sim->bms().set_response_timeout(1000);
+    sim->simulated.set_link({.latency_ms = 30, .loss = 0.3f});
+    EXPECT_EQ(sim->run_cycles(10), 0u);
+  }
+
+  ASSERT_LT(wrapping.simulated.clock().millis(), 0xFFFFFFFF - 3 * UPDATE_INTERVAL);
+  EXPECT_GT(wrapping.bms().get_command_retries(), 0u);
+  EXPECT_EQ(wrapping.bms().get_command_retries(), reference.bms().get_command_retries());
+  EXPECT_EQ(wrapping.bms().get_command_successes(), reference.bms().get_command_successes());
+  EXPECT_EQ(wrapping.bms().get_command_failures(), reference.bms().get_command_failures());
+  EXPECT_EQ(wrapping.bms().get_round_trip_timer().smoothed_rtt_ms(),
+            reference.bms().get_round_trip_timer().smoothed_rtt_ms());
+}
+
+// ── Soak ─────────────────────────────────────────────────────────────────────
+
+// Several thousand poll cycles, about six hours of virtual time over a poor link
+TEST(DalyBmsBleVirtualTimeTest, ThousandsOfLossyPollCycles) {
+  VirtualTimeBms sim(42);
+  sim.bms().set_response_timeout(1000);
+  sim.bms().set_pipeline_depth(2);
+  sim.simulated.set_link({.latency_ms = 40, .jitter_ms = 60, .loss = 0.05f, .reordering = 0.05f,
+                          .corruption = 0.05f});
+
+  const auto wall_start = std::chrono::steady_clock::now();
+  const uint32_t incomplete = sim.run_cycles(4000);
+  const auto wall_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - wall_start).count();
+
+  const auto &stats = sim.simulated.stats();
+  printf("4000 cycles in %lld ms: %" PRIu32 " requests, %" PRIu32 " retries, %" PRIu32 " failures, %" PRIu32
+         " overruns\n",
+         (long long) wall_ms, stats.requests, sim.bms().get_command_retries(), sim.bms().get_command_failures(),
+         sim.bms().get_poll_cycle_overruns());
+
+  EXPECT_EQ(incomplete, 0u);
+  EXPECT_EQ(sim.bms().get_poll_cycle_overruns(), 0u);
+  EXPECT_GT(sim.bms().get_command_retries(), 0u);
+  // Every request is either answered, retried or given up on
+  EXPECT_EQ(sim.bms().get_command_successes() + sim.bms().get_command_retries() + sim.bms().get_command_failures(),
+            stats.requests);
+  EXPECT_TRUE(sim.configured.binary_sensors[0].state);
+  EXPECT_FLOAT_EQ(sim.configured.sensors[0].state, 52.5f);
+}
+
+}  // namespace esphome::daly_bms_ble::testing
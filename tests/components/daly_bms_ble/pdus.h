@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "esphome/core/helpers.h"
+
+namespace esphome::daly_bms_ble::testing {
+
+// A response captured in docs/pdus, together with the read it answers
+struct Pdu {
+  uint8_t function;
+  uint16_t address;
+  uint16_t value;
+  std::vector<uint8_t> response;
+  uint32_t millis{0};  // receive time, relative to the start of the capture
+};
+
+// Text captures carry no timestamps, their responses are spaced one second apart
+static const uint32_t TEXT_CAPTURE_INTERVAL = 1000;
+
+// Parses the bytes of a hex dump line, either "0xD2, 0x03, ..." or "51.03.7C..."
+inline std::vector<uint8_t> parse_hex_line(const std::string &line) {
+  std::vector<uint8_t> bytes;
+  size_t i = 0;
+  while (i < line.size()) {
+    if (line.compare(i, 2, "0x") == 0 || line.compare(i, 2, "0X") == 0) {
+      i += 2;
+      continue;
+    }
+    if (!isxdigit((unsigned char) line[i])) {
+      i++;
+      continue;
+    }
+    size_t end = i;
+    while (end < line.size() && isxdigit((unsigned char) line[end]) && end - i < 2)
+      end++;
+    bytes.push_back((uint8_t) strtoul(line.substr(i, end - i).c_str(), nullptr, 16));
+    i = end;
+  }
+  return bytes;
+}
+
+// Loads a capture. Lines starting with ">>>" are requests, "<<<" and bare hex lines are responses.
+// Captures without requests only contain status frames, which are paired with a status read.
+inline std::vector<Pdu> load_pdus(const std::string &path) {
+  std::vector<Pdu> pdus;
+  std::ifstream file(path);
+  std::string line;
+  std::vector<uint8_t> request;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    if (line.compare(0, 3, ">>>") == 0) {
+      request = parse_hex_line(line.substr(3));
+      continue;
+    }
+    auto response = parse_hex_line(line.compare(0, 3, "<<<") == 0 ? line.substr(3) : line);
+    if (response.size() < 5)
+      continue;
+    const uint32_t millis = pdus.size() * TEXT_CAPTURE_INTERVAL;
+    if (request.size() == 8) {
+      pdus.push_back({request[1], uint16_t(request[2] << 8 | request[3]), uint16_t(request[4] << 8 | request[5]),
+                      std::move(response), millis});
+    } else {
+      pdus.push_back({0x03, 0x0000, uint16_t(response[2] / 2), std::move(response), millis});
+    }
+    request.clear();
+  }
+  return pdus;
+}
+
+inline bool is_valid_frame(const uint8_t *data, size_t length) {
+  return length >= 5 && crc16(data, length - 2) == (uint16_t(data[length - 2]) | uint16_t(data[length - 1]) << 8);
+}
+
+// Parses a btsnoop HCI log (H4 datalink). Reads written to the BMS are paired with the frames of the notifications
+// in request order: a read by its register count, a write by its echoed address. Unanswered requests are dropped.
+inline std::vector<Pdu> parse_btsnoop(const std::vector<uint8_t> &log) {
+  static const uint8_t MAGIC[8] = {'b', 't', 's', 'n', 'o', 'o', 'p', 0};
+  auto get_32bit = [&](size_t i) -> uint32_t {
+    return uint32_t(log[i]) << 24 | uint32_t(log[i + 1]) << 16 | uint32_t(log[i + 2]) << 8 | uint32_t(log[i + 3]);
+  };
+
+  std::vector<Pdu> pdus;
+  if (log.size() < 16 || !std::equal(MAGIC, MAGIC + 8, log.begin()))
+    return pdus;
+
+  struct Request {
+    uint8_t start;
+    uint8_t function;
+    uint16_t address;
+    uint16_t value;
+    uint64_t timestamp;
+  };
+  // Requests not answered within this time are dropped, like the component does after its response timeout
+  static const uint64_t REQUEST_TIMEOUT_US = 5000000;
+  std::vector<Request> requests;
+  std::vector<uint8_t> received;
+  uint64_t first_timestamp = 0;
+
+  // Record: original length, included length, flags, drops, timestamp (us), packet
+  for (size_t offset = 16; offset + 24 <= log.size();) {
+    const uint32_t length = get_32bit(offset + 4);
+    const uint32_t flags = get_32bit(offset + 8);
+    const uint64_t timestamp = uint64_t(get_32bit(offset + 16)) << 32 | get_32bit(offset + 20);
+    const uint8_t *packet = log.data() + offset + 24;
+    offset += 24 + length;
+    if (offset > log.size())
+      break;
+    if (first_timestamp == 0)
+      first_timestamp = timestamp;
+
+    // H4 ACL data: type, handle (2), length (2), L2CAP length (2), CID (2), ATT opcode, attribute handle (2), value
+    if (length < 12 || packet[0] != 0x02 || (packet[7] | packet[8] << 8) != 0x0004)
+      continue;
+    const uint8_t opcode = packet[9];
+    const uint8_t *value = packet + 12;
+    const size_t value_length = length - 12;
+
+    // Write request or write command
+    if ((flags & 1) == 0 && (opcode == 0x12 || opcode == 0x52)) {
+      if (value_length == 8 && (value[0] == 0xD2 || value[0] == 0x81) && (value[1] == 0x03 || value[1] == 0x06))
+        requests.push_back({value[0], value[1], uint16_t(value[2] << 8 | value[3]), uint16_t(value[4] << 8 | value[5]),
+                            timestamp});
+      continue;
+    }
+    // Handle value notification, may carry several frames or a part of one
+    if ((flags & 1) == 0 || opcode != 0x1B)
+      continue;
+    received.insert(received.end(), value, value + value_length);
+    auto expired = [&](const Request &request) { return timestamp - request.timestamp > REQUEST_TIMEOUT_US; };
+    requests.erase(std::remove_if(requests.begin(), requests.end(), expired), requests.end());
+
+    while (received.size() >= 3) {
+      const bool start = received[0] == 0xD2 || received[0] == 0x51;
+      const bool function = received[1] == 0x03 || received[1] == 0x06;
+      const size_t frame_length = received[1] == 0x06 ? 8 : received[2] + 5;
+      if (start && function && received.size() < frame_length)
+        break;
+      if (!start || !function || !is_valid_frame(received.data(), frame_length)) {
+        received.erase(received.begin());
+        continue;
+      }
+
+      std::vector<uint8_t> frame(received.begin(), received.begin() + frame_length);
+      received.erase(received.begin(), received.begin() + frame_length);
+      const uint8_t request_start = frame[0] == 0xD2 ? 0xD2 : 0x81;
+      const uint16_t echoed_address = uint16_t(frame[2] << 8 | frame[3]);
+      auto it = std::find_if(requests.begin(), requests.end(), [&](const Request &request) {
+        if (request.start != request_start || request.function != frame[1])
+          return false;
+        return request.function == 0x06 ? request.address == echoed_address : request.value * 2 == frame[2];
+      });
+      if (it == requests.end())
+        continue;
+      pdus.push_back({it->function, it->address, it->value, std::move(frame),
+                      uint32_t((timestamp - first_timestamp) / 1000)});
+      requests.erase(it);
+    }
+  }
+  return pdus;
+}
+
+// Loads a btsnoop HCI log or a text capture
+inline std::vector<Pdu> load_capture(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (content.size() >= 8 && std::equal(content.begin(), content.begin() + 8, "btsnoop"))
+    return parse_btsnoop(content);
+  return load_pdus(path);
+}
+
+// Directory of the captures, taken from DALY_BMS_PDUS_DIR. Empty if unset.
+inline std::string pdus_dir() {
+  const char *dir = std::getenv("DALY_BMS_PDUS_DIR");
+  return dir != nullptr ? dir : "";
+}
+
+}  // namespace esphome::daly_bms_ble::testing
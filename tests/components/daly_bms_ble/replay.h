@@ -0,0 +1,143 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "pdus.h"
+
+namespace esphome::daly_bms_ble::testing {
+
+// Feeds captured responses through a component with every entity configured and records each state change
+class Replay {
+ public:
+  struct Sample {
+    uint32_t millis;
+    const char *entity;
+    std::string value;
+  };
+
+  struct Result {
+    size_t frames{0};
+    size_t bytes{0};
+    uint64_t decode_ns{0};  // spent in the component, without pacing and recording
+    std::vector<Sample> samples;
+
+    double frames_per_second() const { return this->decode_ns != 0 ? this->frames * 1e9 / this->decode_ns : 0.0; }
+  };
+
+  // speed: 0 replays as fast as possible, 1 in real time, 10 ten times faster
+  explicit Replay(float speed = 0.0f) : speed_(speed) {}
+
+  Result run(const std::vector<Pdu> &pdus) {
+    Result result;
+    ConfiguredBms configured;
+    if (!pdus.empty() && pdus.front().response[0] == 0x51)
+      configured.bms.set_protocol_version(0x81);
+    this->collect_entities_(configured);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto &pdu : pdus) {
+      if (this->speed_ > 0.0f)
+        std::this_thread::sleep_until(start + std::chrono::microseconds(int64_t(pdu.millis * 1000.0f / this->speed_)));
+
+      const auto decode_start = std::chrono::steady_clock::now();
+      configured.bms.queue_sent_command_(pdu.function, pdu.address, pdu.value);
+      configured.bms.on_daly_bms_ble_notify(pdu.response.data(), pdu.response.size());
+      result.decode_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                               decode_start)
+                              .count();
+      result.frames++;
+      result.bytes += pdu.response.size();
+      this->record_changes_(pdu.millis, result.samples);
+    }
+    this->pending_commands_ = configured.bms.queue_size();
+    return result;
+  }
+
+  // Commands of the last run which never got a response
+  uint8_t pending_commands() const { return this->pending_commands_; }
+
+  static void write_csv(const Result &result, std::ostream &out) {
+    out << "millis,entity,value\n";
+    for (const auto &sample : result.samples)
+      out << sample.millis << ',' << sample.entity << ",\"" << sample.value << "\"\n";
+  }
+
+ protected:
+  struct Entity {
+    const char *name;
+    std::function<std::string()> format;
+    std::string last;
+  };
+
+  static std::string format_float(float value) {
+    if (std::isnan(value))
+      return "nan";
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%.3f", value);
+    return buffer;
+  }
+
+  void collect_entities_(ConfiguredBms &configured) {
+    static std::string cell_names[48], temperature_names[8], number_names[41];
+    this->entities_.clear();
+    for (size_t i = 0; i < 35; i++) {
+      sensor::Sensor *s = &configured.sensors[i];
+      this->entities_.push_back({ConfiguredBms::SENSOR_NAMES[i], [s] { return format_float(s->state); }, ""});
+    }
+    for (size_t i = 0; i < 48; i++) {
+      cell_names[i] = "cell_voltage_" + std::to_string(i + 1);
+      sensor::Sensor *s = &configured.cells[i];
+      this->entities_.push_back({cell_names[i].c_str(), [s] { return format_float(s->state); }, ""});
+    }
+    for (size_t i = 0; i < 8; i++) {
+      temperature_names[i] = "temperature_" + std::to_string(i + 1);
+      sensor::Sensor *s = &configured.temperatures[i];
+      this->entities_.push_back({temperature_names[i].c_str(), [s] { return format_float(s->state); }, ""});
+    }
+    for (size_t i = 0; i < 5; i++) {
+      binary_sensor::BinarySensor *s = &configured.binary_sensors[i];
+      this->entities_.push_back(
+          {ConfiguredBms::BINARY_SENSOR_NAMES[i], [s] { return std::string(ONOFF(s->state)); }, ""});
+    }
+    for (size_t i = 0; i < 4; i++) {
+      text_sensor::TextSensor *s = &configured.text_sensors[i];
+      this->entities_.push_back({ConfiguredBms::TEXT_SENSOR_NAMES[i], [s] { return s->state; }, ""});
+    }
+    for (size_t i = 0; i < 3; i++) {
+      switch_::Switch *s = &configured.switches[i];
+      this->entities_.push_back({ConfiguredBms::SWITCH_NAMES[i], [s] { return std::string(ONOFF(s->state)); }, ""});
+    }
+    for (size_t i = 0; i < 41; i++) {
+      char name[24];
+      snprintf(name, sizeof(name), "setting_0x%04X", unsigned(0x0080 + i));
+      number_names[i] = name;
+      number::Number *n = &configured.numbers[i];
+      this->entities_.push_back({number_names[i].c_str(), [n] { return format_float(n->state); }, ""});
+    }
+    // Only changes against the initial states are recorded
+    for (auto &entity : this->entities_)
+      entity.last = entity.format();
+  }
+
+  void record_changes_(uint32_t millis, std::vector<Sample> &samples) {
+    for (auto &entity : this->entities_) {
+      std::string value = entity.format();
+      if (value == entity.last)
+        continue;
+      samples.push_back({millis, entity.name, value});
+      entity.last = std::move(value);
+    }
+  }
+
+  float speed_;
+  std::vector<Entity> entities_;
+  uint8_t pending_commands_{0};
+};
+
+}  // namespace esphome::daly_bms_ble::testing
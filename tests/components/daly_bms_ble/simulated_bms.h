@@ -0,0 +1,204 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "esphome/core/helpers.h"
+#include "common.h"
+
+namespace esphome::daly_bms_ble::testing {
+
+// Virtual time shared by the component and the simulated BMS, advanced by the tests
+class VirtualClock : public DalyBmsClock {
+ public:
+  explicit VirtualClock(uint32_t start = 0) : now_(start) {}
+  uint32_t millis() const override { return this->now_; }
+  void advance(uint32_t ms) { this->now_ += ms; }
+
+ protected:
+  uint32_t now_;
+};
+
+// Register image of a Daly BMS, answers read and write requests like the real device would
+class BmsRegisterImage {
+ public:
+  static const uint16_t REGISTERS = 0x0300;
+
+  explicit BmsRegisterImage(uint8_t protocol_version) : protocol_version_(protocol_version), registers_(REGISTERS) {}
+
+  // Copies the registers of a captured read response into the image, starting at address
+  void load_frame(uint16_t address, const std::vector<uint8_t> &frame) {
+    for (size_t i = 3; i + 3 < frame.size() && address < REGISTERS; i += 2)
+      this->registers_[address++] = uint16_t(frame[i] << 8 | frame[i + 1]);
+  }
+  void set_register(uint16_t address, uint16_t value) { this->registers_[address] = value; }
+  uint16_t get_register(uint16_t address) const { return this->registers_[address]; }
+
+  // Builds the response to a request frame, false if the BMS would ignore it
+  bool respond(const uint8_t *data, size_t length, std::vector<uint8_t> &response) {
+    if (length != 8 || data[0] != this->protocol_version_ || crc16(data, 6) != uint16_t(data[6] | data[7] << 8))
+      return false;
+
+    const uint8_t start = this->protocol_version_ == 0x81 ? 0x51 : 0xD2;
+    const uint16_t address = data[2] << 8 | data[3];
+    const uint16_t value = data[4] << 8 | data[5];
+    if (data[1] == 0x06) {
+      if (address < REGISTERS)
+        this->registers_[address] = value;
+      response.assign(data, data + 6);
+      response[0] = start;
+    } else if (data[1] == 0x03) {
+      const uint16_t count = std::min<uint16_t>(value, 127);
+      response = {start, 0x03, uint8_t(count * 2)};
+      for (uint16_t i = 0; i < count; i++) {
+        const uint16_t reg = address + i < REGISTERS ? this->registers_[address + i] : 0;
+        response.push_back(reg >> 8);
+        response.push_back(reg & 0xFF);
+      }
+    } else {
+      return false;
+    }
+    const uint16_t crc = crc16(response.data(), response.size());
+    response.push_back(crc & 0xFF);
+    response.push_back(crc >> 8);
+    return true;
+  }
+
+ protected:
+  uint8_t protocol_version_;
+  std::vector<uint16_t> registers_;
+};
+
+// In-process Daly BMS answering reads and writes from a register image over a lossy link.
+// Responses are notified to the component from loop() once their latency has passed on the virtual clock.
+class SimulatedBms : public DalyBmsTransport, public BmsRegisterImage {
+ public:
+  struct Link {
+    uint32_t latency_ms{20};
+    uint32_t jitter_ms{0};
+    uint16_t notification_size{20};  // responses are fragmented into notifications of this size
+    float loss{0.0f};                // probability a request gets no response
+    float reordering{0.0f};          // probability a response is held back behind the next ones
+    float corruption{0.0f};          // probability a bit of the response is flipped
+  };
+
+  struct Stats {
+    uint32_t requests{0};
+    uint32_t responses{0};
+    uint32_t lost{0};
+    uint32_t reordered{0};
+    uint32_t corrupted{0};
+    uint32_t notifications{0};
+  };
+
+  SimulatedBms(DalyBmsBle *bms, uint8_t protocol_version, uint32_t seed = 1, uint32_t start_millis = 0)
+      : BmsRegisterImage(protocol_version), random_(seed), clock_(start_millis) {
+    bms->set_protocol_version(protocol_version);
+    bms->set_transport(this);
+    bms->set_clock(&this->clock_);
+  }
+
+  void set_link(const Link &link) { this->link_ = link; }
+  void set_connected(bool connected) { this->connected_ = connected; }
+  const Stats &stats() const { return this->stats_; }
+  VirtualClock &clock() { return this->clock_; }
+
+  // No response is on its way
+  bool idle() const { return this->pending_.empty(); }
+
+  bool is_connected() const override { return this->connected_; }
+
+  bool write_frame(const uint8_t *data, size_t length) override {
+    if (!this->connected_)
+      return false;
+    this->stats_.requests++;
+    std::vector<uint8_t> response;
+    if (!this->respond(data, length, response))
+      return true;
+    if (this->chance_(this->link_.loss)) {
+      this->stats_.lost++;
+      return true;
+    }
+
+    if (this->chance_(this->link_.corruption)) {
+      this->stats_.corrupted++;
+      response[this->random_() % response.size()] ^= 1 << (this->random_() % 8);
+    }
+    uint32_t due = this->clock_.millis() + this->link_.latency_ms;
+    if (this->link_.jitter_ms != 0)
+      due += this->random_() % (this->link_.jitter_ms + 1);
+    if (this->chance_(this->link_.reordering)) {
+      this->stats_.reordered++;
+      due += this->link_.latency_ms + 1;
+    }
+    this->stats_.responses++;
+    for (size_t i = 0; i < response.size(); i += this->link_.notification_size) {
+      const size_t end = std::min(response.size(), i + this->link_.notification_size);
+      this->pending_.push_back({due, std::vector<uint8_t>(response.begin() + i, response.begin() + end)});
+    }
+    return true;
+  }
+
+  // Notifies the component of every fragment which is due, in order of arrival
+  void loop() override {
+    const uint32_t now = this->clock_.millis();
+    while (true) {
+      auto due = std::min_element(this->pending_.begin(), this->pending_.end(),
+                                  [](const Notification &a, const Notification &b) { return a.due < b.due; });
+      if (due == this->pending_.end() || int32_t(now - due->due) < 0)
+        break;
+      const auto value = std::move(due->value);
+      this->pending_.erase(due);
+      if (!this->connected_)
+        continue;
+      this->stats_.notifications++;
+      this->engine_->on_daly_bms_ble_notify(value.data(), value.size());
+    }
+  }
+
+ protected:
+  struct Notification {
+    uint32_t due;
+    std::vector<uint8_t> value;
+  };
+
+  bool chance_(float probability) {
+    return probability > 0.0f && std::uniform_real_distribution<float>(0.0f, 1.0f)(this->random_) < probability;
+  }
+
+  std::mt19937 random_;
+  std::vector<Notification> pending_;
+  VirtualClock clock_;
+  Link link_;
+  Stats stats_;
+  bool connected_{true};
+};
+
+// Outcome of one poll cycle driven through update() and loop()
+struct PollCycle {
+  uint32_t duration_ms;
+  uint8_t max_queue_size;
+  bool completed;  // every queued command was answered or given up on
+};
+
+// Advances the virtual clock by 1 ms and runs the main loop, which polls the simulated link
+inline void step(TestableDalyBmsBle &bms, SimulatedBms &simulated) {
+  simulated.clock().advance(1);
+  bms.loop();
+}
+
+// Runs update() and then the main loop until the command queue drained or timeout_ms passed
+inline PollCycle run_poll_cycle(TestableDalyBmsBle &bms, SimulatedBms &simulated, uint32_t timeout_ms = 30000) {
+  const uint32_t start = simulated.clock().millis();
+  bms.update();
+  PollCycle cycle{0, bms.queue_size(), false};
+  while (bms.queue_size() > 0 && simulated.clock().millis() - start < timeout_ms) {
+    step(bms, simulated);
+    cycle.max_queue_size = std::max(cycle.max_queue_size, bms.queue_size());
+  }
+  cycle.duration_ms = simulated.clock().millis() - start;
+  cycle.completed = bms.queue_size() == 0;
+  return cycle;
+}
+
+}  // namespace esphome::daly_bms_ble::testing
@@ -20,6 +20,33 @@ class TestHubConstants:
     def test_conf_ids_defined(self):
         assert hub.CONF_DALY_BMS_BLE_ID == "daly_bms_ble_id"
         assert hub.CONF_STATUS_REGISTERS == "status_registers"
+        assert hub.CONF_PIPELINE_DEPTH == "pipeline_depth"
+        assert hub.CONF_READ_RETRIES == "read_retries"
+        assert hub.CONF_WRITE_RETRIES == "write_retries"
+        assert hub.CONF_RETRY_BACKOFF == "retry_backoff"
+        assert hub.CONF_ALARMS_UPDATE_INTERVAL == "alarms_update_interval"
+        assert hub.CONF_SETTINGS_UPDATE_INTERVAL == "settings_update_interval"
+        assert hub.CONF_MTU == "mtu"
+        assert hub.CONF_ACTIVE_CONNECTION_INTERVAL == "active_connection_interval"
+        assert hub.CONF_IDLE_CONNECTION_INTERVAL == "idle_connection_interval"
+        assert hub.CONF_CACHE_GATT_HANDLES == "cache_gatt_handles"
+        assert hub.CONF_HEARTBEAT_INTERVAL == "heartbeat_interval"
+        assert hub.CONF_CELL_VOLTAGE_DEADBAND == "cell_voltage_deadband"
+        assert hub.CONF_TEMPERATURE_DEADBAND == "temperature_deadband"
+        assert hub.CONF_CURRENT_DEADBAND == "current_deadband"
+        assert hub.CONF_STATE_OF_CHARGE_DEADBAND == "state_of_charge_deadband"
+        assert hub.CONF_HOST_DEVICE == "host_device"
+
+    def test_transport_keys(self):
+        assert hub.TRANSPORT_KEYS == ("ble_client_id", "uart_id", "host_device")
+
+    def test_ble_only_keys(self):
+        assert hub.BLE_ONLY_KEYS == (
+            "mtu",
+            "active_connection_interval",
+            "idle_connection_interval",
+            "cache_gatt_handles",
+        )
 
 
 class TestSensorLists:
@@ -45,13 +72,21 @@ class TestSensorLists:
         assert "total_voltage" in sensor.SENSOR_DEFS
         assert "state_of_charge" in sensor.SENSOR_DEFS
         assert "error_bitmask" in sensor.SENSOR_DEFS
-        assert len(sensor.SENSOR_DEFS) == 25
+        assert "round_trip_time" in sensor.SENSOR_DEFS
+        assert "mtu" in sensor.SENSOR_DEFS
+        assert "connection_interval" in sensor.SENSOR_DEFS
+        assert len(sensor.SENSOR_DEFS) == 35
 
     def test_no_cell_keys_in_sensors_list(self):
         for key in sensor.SENSOR_DEFS:
             assert key not in sensor.CELLS
             assert key not in sensor.TEMPERATURES
 
+    def test_feature_sensors_are_known(self):
+        known = set(sensor.SENSOR_DEFS) | set(sensor.CELLS)
+        assert set(sensor.CELL_VOLTAGE_FEATURE_SENSORS) <= known
+        assert set(sensor.POWER_FEATURE_SENSORS) <= known
+
 
 class TestBinarySensorConstants:
     def test_binary_sensor_defs_dict(self):
@@ -86,6 +121,10 @@ class TestButtonConstants:
         addresses = [address for _, address, _ in button.BUTTONS.values()]
         assert len(addresses) == len(set(addresses))
 
+    def test_dump_diagnostics_is_not_a_command(self):
+        assert button.CONF_DUMP_DIAGNOSTICS == "dump_diagnostics"
+        assert button.CONF_DUMP_DIAGNOSTICS not in button.BUTTONS
+
 
 class TestNumberConstants:
     def test_numbers_count(self):